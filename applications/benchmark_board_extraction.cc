@@ -0,0 +1,146 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/core/board_extractor.h"
+#include "OpenCameraCalibrator/utils/utils.h"
+
+using namespace OpenICC;
+using namespace OpenICC::core;
+
+DEFINE_string(input_videos, "", "Comma separated reference videos.");
+DEFINE_string(board_type, "charuco",
+              "Board type. charuco compares the classic and the ArUco3 marker "
+              "detection, radon the exhaustive search and the tracker.");
+DEFINE_string(aruco_detector_params, "", "Path detector yaml.");
+DEFINE_double(downsample_factor, 2.0,
+              "Downsample factor for images. I_new = 1/factor * I");
+DEFINE_double(checker_square_length_m, 0.022,
+              "Size of one square on the checkerbaord in [m].");
+DEFINE_int32(num_squares_x, 9,
+             "Number of squares in x (inner corners for radon, e.g. 14).");
+DEFINE_int32(num_squares_y, 7,
+             "Number of squares in y (inner corners for radon, e.g. 9).");
+DEFINE_int32(aruco_dict, cv::aruco::DICT_ARUCO_ORIGINAL,
+             "Aruco dictionary id.");
+DEFINE_int32(max_frames, 300, "Maximum number of frames per video.");
+
+struct BenchmarkResult {
+  int nr_frames = 0;
+  int frames_with_corners = 0;
+  int nr_corners = 0;
+  double time_s = 0.0;
+};
+
+// Decodes the frames up front, so only the detection is timed
+std::vector<cv::Mat> LoadFrames(const std::string &video_path) {
+  std::vector<cv::Mat> frames;
+  cv::VideoCapture video(video_path);
+  if (!video.isOpened()) {
+    LOG(ERROR) << "Could not open " << video_path;
+    return frames;
+  }
+  const double fxfy = 1. / FLAGS_downsample_factor;
+  cv::Mat frame, image;
+  while (static_cast<int>(frames.size()) < FLAGS_max_frames &&
+         video.read(frame)) {
+    cv::resize(frame, image, cv::Size(), fxfy, fxfy);
+    cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+    frames.push_back(image.clone());
+  }
+  return frames;
+}
+
+// fast: ArUco3 detection for charuco boards, tracking for radon boards
+BenchmarkResult RunDetection(const std::vector<cv::Mat> &frames,
+                             const bool fast) {
+  BoardExtractor board_extractor;
+  if (StringToBoardType(FLAGS_board_type) == BoardType::CHARUCO) {
+    board_extractor.InitializeCharucoBoard(
+        FLAGS_aruco_detector_params, FLAGS_checker_square_length_m / 2.0f,
+        FLAGS_checker_square_length_m, FLAGS_num_squares_x,
+        FLAGS_num_squares_y, FLAGS_aruco_dict);
+    board_extractor.SetAruco3Detection(fast);
+  } else {
+    board_extractor.InitializeRadonBoard(FLAGS_checker_square_length_m,
+                                         FLAGS_num_squares_x,
+                                         FLAGS_num_squares_y);
+    board_extractor.SetRoiTracking(fast);
+  }
+  DetectorState state = board_extractor.CloneDetectorState();
+
+  BenchmarkResult result;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < frames.size(); ++i) {
+    aligned_vector<Eigen::Vector2d> corners;
+    std::vector<int> ids;
+    state.frame_idx = i;
+    board_extractor.ExtractBoard(frames[i], state, corners, ids);
+    ++result.nr_frames;
+    if (!ids.empty()) {
+      ++result.frames_with_corners;
+      result.nr_corners += ids.size();
+    }
+  }
+  result.time_s = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return result;
+}
+
+void PrintBenchmarkResult(const std::string &name, const BenchmarkResult &result) {
+  LOG(INFO) << name << ": " << result.nr_frames / std::max(result.time_s, 1e-9)
+            << " frames/s, board found in " << result.frames_with_corners
+            << " / " << result.nr_frames << " frames ("
+            << 100.0 * result.frames_with_corners /
+                   std::max(1, result.nr_frames)
+            << "%), " << result.nr_corners << " corners.";
+}
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  const bool charuco =
+      StringToBoardType(FLAGS_board_type) == BoardType::CHARUCO;
+#if !OPENICC_HAS_ARUCO3
+  LOG_IF(WARNING, charuco)
+      << "OpenCV < 4.5.3, both runs use the classic detection.";
+#endif
+
+  std::stringstream video_list(FLAGS_input_videos);
+  std::string video_path;
+  while (std::getline(video_list, video_path, ',')) {
+    const std::vector<cv::Mat> frames = LoadFrames(video_path);
+    if (frames.empty()) {
+      continue;
+    }
+    LOG(INFO) << video_path << " (" << frames.size() << " frames)";
+    PrintBenchmarkResult(charuco ? "classic" : "exhaustive",
+                         RunDetection(frames, false));
+    PrintBenchmarkResult(charuco ? "ArUco3" : "tracking",
+                         RunDetection(frames, true));
+  }
+  return 0;
+}
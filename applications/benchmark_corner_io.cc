@@ -0,0 +1,260 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <malloc.h>
+#include <map>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "OpenCameraCalibrator/io/corner_archive.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/utils/json.h"
+
+using namespace OpenICC;
+
+DEFINE_string(input_corners, "",
+              "Corner file (.uson) to load. If empty, a synthetic file is "
+              "written to --synthetic_path.");
+DEFINE_string(synthetic_path, "/tmp/benchmark_corner_io.uson",
+              "Path of the synthetic corner file.");
+DEFINE_int32(num_views, 20000, "Number of views of the synthetic file.");
+DEFINE_int32(corners_per_view, 40, "Number of corners per synthetic view.");
+DEFINE_int32(num_runs, 3, "Number of loads per reader.");
+
+// The reader before the memory mapped loader: the file is copied byte by
+// byte to a vector that is then parsed.
+bool ReadSceneBsonByteCopy(const std::string &input_bson,
+                           nlohmann::json &scene_json) {
+  std::ifstream input_corner_json(input_bson, std::ios::binary);
+  if (!input_corner_json.is_open()) {
+    return false;
+  }
+  std::uint8_t cont;
+  std::vector<std::uint8_t> uson_file_content;
+  while (
+      input_corner_json.read(reinterpret_cast<char *>(&cont), sizeof(cont))) {
+    uson_file_content.push_back(cont);
+  }
+  scene_json = nlohmann::json::from_ubjson(uson_file_content);
+  return true;
+}
+
+bool WriteSyntheticCorners(const std::string &path) {
+  nlohmann::json scene_json;
+  scene_json["camera_fps"] = 60.0;
+  scene_json["calibration_board_type"] = 0; // charuco
+  scene_json["square_size_meter"] = 0.02;
+  scene_json["image_width"] = 1920;
+  scene_json["image_height"] = 1080;
+  for (int i = 0; i < FLAGS_corners_per_view; ++i) {
+    scene_json["scene_pts"][std::to_string(i)] = {0.02 * (i % 10),
+                                                  0.02 * (i / 10), 0.0};
+  }
+  for (int v = 0; v < FLAGS_num_views; ++v) {
+    const std::string view_us = std::to_string(v * 1e6 / 60.0);
+    for (int i = 0; i < FLAGS_corners_per_view; ++i) {
+      scene_json["views"][view_us]["image_points"][std::to_string(i)] = {
+          100.0 + 40.0 * (i % 10) + 30.0 * std::sin(1e-3 * v) +
+              0.1 * std::sin(v + i),
+          100.0 + 40.0 * (i / 10) + 20.0 * std::cos(1e-3 * v)};
+    }
+  }
+  const std::vector<std::uint8_t> uson = nlohmann::json::to_ubjson(scene_json);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(uson.data()), uson.size());
+  return file.good();
+}
+
+struct LoadResult {
+  double load_ms = 0.0;
+  // peak resident memory increase during the load
+  long peak_rss_kb = 0;
+  int num_views = 0;
+};
+
+// Returns the number of loaded views, -1 on failure
+using Loader = std::function<int(const std::string &)>;
+
+int LoadJson(const std::function<bool(const std::string &, nlohmann::json &)>
+                 &reader,
+             const std::string &path) {
+  nlohmann::json scene_json;
+  if (!reader(path, scene_json)) {
+    return -1;
+  }
+  return scene_json["views"].size();
+}
+
+int LoadDataset(const std::string &path) {
+  io::CornerDataset dataset;
+  return dataset.Load(path) ? static_cast<int>(dataset.NumViews()) : -1;
+}
+
+// Loads in a forked child, such that the peak memory of one reader does not
+// hide the peak of the next one
+bool MeasureLoad(const Loader &loader, const std::string &path,
+                 LoadResult &result) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const long rss_before_kb = usage.ru_maxrss;
+    LoadResult child_result;
+    const auto start = std::chrono::steady_clock::now();
+    child_result.num_views = loader(path);
+    child_result.load_ms = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    getrusage(RUSAGE_SELF, &usage);
+    child_result.peak_rss_kb = usage.ru_maxrss - rss_before_kb;
+    const ssize_t written =
+        write(fds[1], &child_result, sizeof(child_result));
+    close(fds[1]);
+    _exit(written == sizeof(child_result) ? 0 : 1);
+  }
+  close(fds[1]);
+  const ssize_t nr_read = read(fds[0], &result, sizeof(result));
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return nr_read == sizeof(result) && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0 && result.num_views >= 0;
+}
+
+double FileSizeMB(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  CHECK(file.is_open()) << "Could not open " << path;
+  return file.tellg() / (1024.0 * 1024.0);
+}
+
+// Largest corner difference between two datasets of the same views
+double MaxCornerError(const io::CornerDataset &a, const io::CornerDataset &b) {
+  double max_error = 0.0;
+  for (size_t v = 0; v < a.NumViews() && v < b.NumViews(); ++v) {
+    // both are sorted by point id within the archive, compare by id
+    std::map<int, Eigen::Vector2d> corners;
+    for (size_t c = a.ViewBegin(v); c < a.ViewEnd(v); ++c) {
+      corners[a.PointId(c)] = a.Corner(c);
+    }
+    for (size_t c = b.ViewBegin(v); c < b.ViewEnd(v); ++c) {
+      const auto it = corners.find(b.PointId(c));
+      if (it != corners.end()) {
+        max_error = std::max(max_error, (it->second - b.Corner(c)).norm());
+      }
+    }
+  }
+  return max_error;
+}
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::string path = FLAGS_input_corners;
+  if (path.empty()) {
+    path = FLAGS_synthetic_path;
+    CHECK(WriteSyntheticCorners(path)) << "Could not write " << path;
+  }
+
+  // the same corners in the other formats
+  const std::string stream_path = path + io::kCornerStreamExtension;
+  const std::string archive_path = path + io::kCornerArchiveExtension;
+  const std::string lossless_path = path + ".lossless" +
+                                    io::kCornerArchiveExtension;
+  {
+    nlohmann::json scene_json;
+    CHECK(io::read_scene(path, scene_json)) << "Could not read " << path;
+    CHECK(io::write_scene_corner_stream(scene_json, stream_path));
+    CHECK(io::write_scene_corner_archive(scene_json, archive_path, false));
+    CHECK(io::write_scene_corner_archive(scene_json, lossless_path, true));
+
+    io::CornerDataset original, archived;
+    CHECK(original.Load(path) && archived.Load(archive_path));
+    LOG(INFO) << "Largest fixed point corner error: "
+              << MaxCornerError(original, archived) << " px.";
+  }
+  // give the freed heap back, otherwise the children reuse it without
+  // growing their peak memory
+  malloc_trim(0);
+
+  const double uson_mb = FileSizeMB(path);
+  for (const auto &file : {path, stream_path, archive_path, lossless_path}) {
+    LOG(INFO) << file << ": " << FileSizeMB(file) << " MB ("
+              << 100.0 * FileSizeMB(file) / uson_mb << "% of .uson).";
+  }
+
+  struct Benchmark {
+    std::string name;
+    std::string path;
+    Loader loader;
+  };
+  const std::vector<Benchmark> benchmarks = {
+      {".uson byte copy -> json", path,
+       [](const std::string &p) { return LoadJson(ReadSceneBsonByteCopy, p); }},
+      {".uson memory mapped -> json", path,
+       [](const std::string &p) {
+         return LoadJson(io::read_scene_bson, p);
+       }},
+      {".uson -> CornerDataset", path, LoadDataset},
+      {".oicc -> CornerDataset", stream_path, LoadDataset},
+      {".occz -> CornerDataset", archive_path, LoadDataset},
+      {".occz lossless -> CornerDataset", lossless_path, LoadDataset},
+      {".occz -> json", archive_path, [](const std::string &p) {
+         return LoadJson(io::read_scene_corner_archive, p);
+       }}};
+  LOG(INFO) << "Loading, best of " << FLAGS_num_runs << " runs.";
+  for (const auto &benchmark : benchmarks) {
+    const double file_mb = FileSizeMB(benchmark.path);
+    LoadResult best;
+    best.load_ms = -1.0;
+    for (int r = 0; r < FLAGS_num_runs; ++r) {
+      LoadResult result;
+      if (!MeasureLoad(benchmark.loader, benchmark.path, result)) {
+        LOG(ERROR) << benchmark.name << ": loading failed.";
+        break;
+      }
+      if (best.load_ms < 0.0 || result.load_ms < best.load_ms) {
+        best = result;
+      }
+    }
+    if (best.load_ms < 0.0) {
+      continue;
+    }
+    LOG(INFO) << benchmark.name << ": " << best.num_views << " views in "
+              << best.load_ms << "ms (" << file_mb / (best.load_ms * 1e-3)
+              << " MB/s), peak RSS +" << best.peak_rss_kb / 1024.0 << " MB ("
+              << best.peak_rss_kb / 1024.0 / file_mb << "x file size).";
+  }
+  return 0;
+}
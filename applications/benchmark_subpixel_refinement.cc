@@ -0,0 +1,156 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc.hpp>
+#include <random>
+#include <vector>
+
+#include "OpenCameraCalibrator/core/subpixel_refinement.h"
+
+using namespace OpenICC;
+
+DEFINE_int32(num_images, 50, "Number of synthetic images.");
+DEFINE_int32(square_size_px, 40, "Size of the checkerboard squares.");
+DEFINE_double(blur_sigma, 1.0, "Sigma of the gaussian blur of the images.");
+DEFINE_double(noise_sigma, 2.0, "Sigma of the gray value noise.");
+DEFINE_double(init_error_px, 1.5,
+              "Maximum error of the initial corner positions.");
+DEFINE_int32(half_win, 5, "Half window size of the refinement.");
+
+const int kSupersampling = 8;
+
+// Renders a rotated and shifted checkerboard. The image is rendered at a
+// higher resolution and downsampled, so the corners lie at sub-pixel
+// positions that are known exactly.
+cv::Mat RenderCheckerboard(const double angle, const cv::Point2d &shift,
+                           std::vector<cv::Point2f> &corners) {
+  const int nr_squares = 8;
+  const int size = (nr_squares + 2) * FLAGS_square_size_px;
+  const double s = kSupersampling;
+  const double ca = std::cos(angle), sa = std::sin(angle);
+  const cv::Point2d center(0.5 * size, 0.5 * size);
+
+  cv::Mat hires(size * kSupersampling, size * kSupersampling, CV_8U);
+  for (int y = 0; y < hires.rows; ++y) {
+    for (int x = 0; x < hires.cols; ++x) {
+      // pixel center in low resolution coordinates, back to board coordinates
+      const cv::Point2d p((x + 0.5) / s - 0.5 - center.x - shift.x,
+                          (y + 0.5) / s - 0.5 - center.y - shift.y);
+      const double u = (ca * p.x + sa * p.y) / FLAGS_square_size_px;
+      const double v = (-sa * p.x + ca * p.y) / FLAGS_square_size_px;
+      const bool black =
+          (static_cast<int>(std::floor(u)) + static_cast<int>(std::floor(v))) %
+              2 ==
+          0;
+      hires.at<uchar>(y, x) = black ? 40 : 215;
+    }
+  }
+  cv::Mat image;
+  cv::resize(hires, image, cv::Size(size, size), 0, 0, cv::INTER_AREA);
+
+  corners.clear();
+  for (int i = -nr_squares / 2 + 1; i < nr_squares / 2; ++i) {
+    for (int j = -nr_squares / 2 + 1; j < nr_squares / 2; ++j) {
+      const double u = j * FLAGS_square_size_px, v = i * FLAGS_square_size_px;
+      corners.push_back(cv::Point2f(
+          static_cast<float>(ca * u - sa * v + center.x + shift.x),
+          static_cast<float>(sa * u + ca * v + center.y + shift.y)));
+    }
+  }
+  return image;
+}
+
+double RMSE(const std::vector<cv::Point2f> &a,
+            const std::vector<cv::Point2f> &b) {
+  double sum = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    sum += (a[i].x - b[i].x) * (a[i].x - b[i].x) +
+           (a[i].y - b[i].y) * (a[i].y - b[i].y);
+  }
+  return std::sqrt(sum / std::max<size_t>(1, a.size()));
+}
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> angle_dist(0.0, CV_PI / 2.0);
+  std::uniform_real_distribution<double> shift_dist(-0.5, 0.5);
+  std::uniform_real_distribution<float> init_dist(-FLAGS_init_error_px,
+                                                  FLAGS_init_error_px);
+
+  const cv::TermCriteria criteria(
+      cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 0.01);
+  double sq_err_opencv = 0.0, sq_err_batched = 0.0;
+  double time_opencv_ms = 0.0, time_batched_ms = 0.0;
+  size_t nr_corners = 0;
+  for (int n = 0; n < FLAGS_num_images; ++n) {
+    std::vector<cv::Point2f> gt_corners;
+    cv::Mat image = RenderCheckerboard(
+        angle_dist(rng), cv::Point2d(shift_dist(rng), shift_dist(rng)),
+        gt_corners);
+    cv::GaussianBlur(image, image, cv::Size(0, 0), FLAGS_blur_sigma);
+    cv::Mat noise(image.size(), CV_16S);
+    cv::randn(noise, 0.0, FLAGS_noise_sigma);
+    cv::Mat noisy;
+    image.convertTo(noisy, CV_16S);
+    noisy += noise;
+    noisy.convertTo(image, CV_8U);
+
+    std::vector<cv::Point2f> init_corners = gt_corners;
+    for (auto &pt : init_corners) {
+      pt += cv::Point2f(init_dist(rng), init_dist(rng));
+    }
+
+    std::vector<cv::Point2f> opencv_corners = init_corners;
+    auto start = std::chrono::steady_clock::now();
+    cv::cornerSubPix(image, opencv_corners,
+                     cv::Size(FLAGS_half_win, FLAGS_half_win),
+                     cv::Size(-1, -1), criteria);
+    time_opencv_ms += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+    std::vector<cv::Point2f> batched_corners = init_corners;
+    start = std::chrono::steady_clock::now();
+    core::RefineCornersSubPix(image, batched_corners, FLAGS_half_win,
+                              criteria.maxCount, criteria.epsilon);
+    time_batched_ms += std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+    const double rmse_opencv = RMSE(opencv_corners, gt_corners);
+    const double rmse_batched = RMSE(batched_corners, gt_corners);
+    sq_err_opencv += rmse_opencv * rmse_opencv * gt_corners.size();
+    sq_err_batched += rmse_batched * rmse_batched * gt_corners.size();
+    nr_corners += gt_corners.size();
+  }
+
+  LOG(INFO) << "Refined " << nr_corners << " corners in " << FLAGS_num_images
+            << " synthetic images.";
+  LOG(INFO) << "cv::cornerSubPix:    RMSE "
+            << std::sqrt(sq_err_opencv / nr_corners) << "px, "
+            << time_opencv_ms * 1000.0 / nr_corners << "us/corner";
+  LOG(INFO) << "RefineCornersSubPix: RMSE "
+            << std::sqrt(sq_err_batched / nr_corners) << "px, "
+            << time_batched_ms * 1000.0 / nr_corners << "us/corner";
+  return 0;
+}
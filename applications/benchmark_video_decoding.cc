@@ -0,0 +1,83 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <string>
+
+#include "OpenCameraCalibrator/io/video_capture.h"
+
+using namespace OpenICC;
+
+DEFINE_string(input_video, "", "Video to decode.");
+DEFINE_double(downsample_factor, 2.0,
+              "Downsample factor for images. I_new = 1/factor * I");
+DEFINE_int32(max_frames, 500, "Number of frames to decode per run.");
+
+// Decodes max_frames frames and brings them to the detection resolution.
+// Frames that were not downsampled by the decoder are resized like in
+// BoardExtractor::ExtractVideoToJson.
+double DecodeFramesPerSecond(const io::VideoDecodeOptions &options,
+                             std::string &description) {
+  cv::VideoCapture capture;
+  io::VideoDecodeOptions decoded;
+  if (!io::OpenVideoCapture(FLAGS_input_video, options, capture, decoded)) {
+    LOG(ERROR) << "Could not open " << FLAGS_input_video;
+    return 0.0;
+  }
+  description = std::string(decoded.gray ? "gray" : "BGR") +
+                (decoded.downsample_factor > 1.0 ? " + decoder scaling"
+                                                 : " + cv::resize");
+
+  const double fxfy = 1. / FLAGS_downsample_factor;
+  const auto start = std::chrono::steady_clock::now();
+  int nr_frames = 0;
+  cv::Mat frame, image;
+  while (nr_frames < FLAGS_max_frames && capture.read(frame)) {
+    if (decoded.downsample_factor > 1.0) {
+      image = frame;
+    } else {
+      cv::resize(frame, image, cv::Size(), fxfy, fxfy);
+    }
+    ++nr_frames;
+  }
+  const double elapsed_s = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+  return nr_frames / std::max(elapsed_s, 1e-9);
+}
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  io::VideoDecodeOptions resize_path;
+  io::VideoDecodeOptions decoder_scaling;
+  decoder_scaling.downsample_factor = FLAGS_downsample_factor;
+  io::VideoDecodeOptions gray_decoder_scaling = decoder_scaling;
+  gray_decoder_scaling.gray = true;
+
+  for (const auto &options :
+       {resize_path, decoder_scaling, gray_decoder_scaling}) {
+    std::string description;
+    const double fps = DecodeFramesPerSecond(options, description);
+    LOG(INFO) << description << ": " << fps << " frames/s";
+  }
+  return 0;
+}
@@ -15,7 +15,7 @@
 
 #include <gflags/gflags.h>
 
-#include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
 #include "OpenCameraCalibrator/core/camera_calibrator.h"
 #include "OpenCameraCalibrator/utils/intrinsic_initializer.h"
 #include "OpenCameraCalibrator/utils/json.h"
@@ -40,8 +40,8 @@ int main(int argc, char *argv[]) {
   GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
   ::google::InitGoogleLogging(argv[0]);
 
-  nlohmann::json scene_json;
-  CHECK(io::read_scene_bson(FLAGS_input_corners, scene_json))
+  io::CornerDataset corner_dataset;
+  CHECK(corner_dataset.Load(FLAGS_input_corners))
       << "Failed to load " << FLAGS_input_corners;
 
   CameraCalibrator camera_calibrator(FLAGS_camera_model_to_calibrate, FLAGS_optimize_board_points);
@@ -49,8 +49,8 @@ int main(int argc, char *argv[]) {
   if (FLAGS_verbose) {
     camera_calibrator.SetVerbose();
   }
-  camera_calibrator.CalibrateCameraFromJson(scene_json,
-                                            FLAGS_save_path_calib_dataset);
+  camera_calibrator.CalibrateCamera(corner_dataset,
+                                    FLAGS_save_path_calib_dataset);
   camera_calibrator.PrintResult();
 
   return 0;
@@ -27,13 +27,16 @@
 #include "OpenCameraCalibrator/basalt_spline/calib_helpers.h"
 #include "OpenCameraCalibrator/basalt_spline/ceres_calib_spline_split.h"
 #include "OpenCameraCalibrator/core/imu_camera_calibrator.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
 #include "OpenCameraCalibrator/io/read_camera_calibration.h"
 #include "OpenCameraCalibrator/io/read_gopro_imu_json.h"
 #include "OpenCameraCalibrator/io/read_misc.h"
 #include "OpenCameraCalibrator/io/read_telemetry.h"
 
 #include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/utils/async_visualizer.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/timestamp_view_index.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
@@ -65,6 +68,9 @@ DEFINE_bool(reestimate_biases, false,
             "spline optim");
 DEFINE_string(debug_video_path, "",
               "Load the video to display the reprojection error.");
+DEFINE_string(debug_video_output, "",
+              "Write the reprojection error frames to this video instead of "
+              "displaying them (headless).");
 
 using json = nlohmann::json;
 
@@ -87,8 +93,8 @@ int main(int argc, char *argv[]) {
   theia::Reconstruction pose_dataset;
   CHECK(theia::ReadReconstruction(FLAGS_input_pose_dataset, &pose_dataset))
       << "Could not read Reconstruction file.";
-  nlohmann::json scene_json;
-  CHECK(io::read_scene_bson(FLAGS_input_corners, scene_json))
+  io::CornerDataset corner_dataset;
+  CHECK(corner_dataset.Load(FLAGS_input_corners))
       << "Failed to load " << FLAGS_input_corners;
 
   theia::Camera camera;
@@ -109,18 +115,19 @@ int main(int argc, char *argv[]) {
       (*new_point)[j] = old_track->Point()[j];
     }
   }
-  for (const auto &view : scene_json["views"].items()) {
-    const double timestamp_us = std::stod(view.key());
-    const double timestamp_s = timestamp_us * US_TO_S; // to seconds
-    std::string view_name = std::to_string((uint64_t)timestamp_us);
-    theia::ViewId view_id =
-        recon_calib_dataset.AddView(view_name, 0, timestamp_s);
-
-    theia::ViewId old_view_id = pose_dataset.ViewIdFromName(view_name);
+  // the pose timestamps were stored as seconds, allow for rounding
+  const utils::TimestampViewIndex pose_index(pose_dataset);
+  const int64_t max_pose_distance_ns = 1000;
+  for (size_t v = 0; v < corner_dataset.NumViews(); ++v) {
+    const int64_t timestamp_ns = corner_dataset.TimestampNs(v);
+    const theia::ViewId old_view_id =
+        pose_index.FindNearest(timestamp_ns, max_pose_distance_ns);
     if (old_view_id == theia::kInvalidViewId) {
-      recon_calib_dataset.RemoveView(view_id);
       continue;
     }
+    theia::ViewId view_id = recon_calib_dataset.AddView(
+        utils::ViewNameFromTimestampNs(timestamp_ns), 0,
+        corner_dataset.TimestampS(v));
     theia::View *view_new = recon_calib_dataset.MutableView(view_id);
     theia::Camera *mutable_cam = view_new->MutableCamera();
     const theia::Camera cam_old = pose_dataset.View(old_view_id)->Camera();
@@ -130,12 +137,10 @@ int main(int argc, char *argv[]) {
     mutable_cam->SetFromCameraIntrinsicsPriors(
         camera.CameraIntrinsicsPriorFromIntrinsics());
 
-    const auto image_points = view.value()["image_points"];
-    for (const auto &img_pts : image_points.items()) {
-      const int board_pt3_id = std::stoi(img_pts.key());
-      const Eigen::Vector2d corner(
-          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
-      recon_calib_dataset.AddObservation(view_id, board_pt3_id, corner);
+    for (size_t c = corner_dataset.ViewBegin(v); c < corner_dataset.ViewEnd(v);
+         ++c) {
+      recon_calib_dataset.AddObservation(view_id, corner_dataset.PointId(c),
+                                         corner_dataset.Corner(c));
     }
   }
 
@@ -265,12 +270,15 @@ int main(int argc, char *argv[]) {
 
   // read camera calibration
   theia::Reconstruction output_spline_recon;
+  utils::TimestampViewIndex spline_index;
   for (size_t i = 0; i < cam_timestamps_s.size(); ++i) {
     const int64_t t_ns = cam_timestamps_s[i] * S_TO_NS;
     Sophus::SE3d T_w_i = imu_cam_calibrator.trajectory_.getPose(t_ns);
     Sophus::SE3d T_w_c = T_w_i * imu_cam_calibrator.trajectory_.getT_i_c();
-    theia::ViewId v_id_theia =
-        output_spline_recon.AddView(std::to_string(t_ns), 0, t_ns);
+    // view timestamps of spline reconstructions are in ns
+    theia::ViewId v_id_theia = output_spline_recon.AddView(
+        utils::ViewNameFromTimestampNs(t_ns), 0, t_ns);
+    spline_index.Add(t_ns, v_id_theia);
     theia::View *view = output_spline_recon.MutableView(v_id_theia);
     view->SetEstimated(true);
     theia::Camera *camera_ptr = view->MutableCamera();
@@ -292,30 +300,49 @@ int main(int argc, char *argv[]) {
 
   if (FLAGS_debug_video_path != "") {
 
-    nlohmann::json scene_json;
-    CHECK(io::read_scene_bson(FLAGS_input_corners, scene_json))
-        << "Failed to load " << FLAGS_input_corners;
-
     theia::Reconstruction recon_calib_dataset;
-
-    io::scene_points_to_calib_dataset(scene_json, recon_calib_dataset);
-    for (const auto &view : scene_json["views"].items()) {
-      const double timestamp_us = std::stod(view.key());
-      const double timestamp_s = timestamp_us * 1e-6; // to seconds
-      const auto image_points = view.value()["image_points"];
-      std::string view_name = std::to_string((uint64_t)(timestamp_s * S_TO_NS));
-      theia::ViewId view_id =
-          recon_calib_dataset.AddView(view_name, 0, timestamp_s);
-
-      for (const auto &img_pts : image_points.items()) {
-        const int board_pt3_id = std::stoi(img_pts.key());
-        const Eigen::Vector2d corner(
-            Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
-        recon_calib_dataset.AddObservation(view_id, board_pt3_id, corner);
+    utils::TimestampViewIndex calib_index;
+
+    io::scene_points_to_calib_dataset(corner_dataset, recon_calib_dataset);
+    for (size_t v = 0; v < corner_dataset.NumViews(); ++v) {
+      const int64_t timestamp_ns = corner_dataset.TimestampNs(v);
+      theia::ViewId view_id = recon_calib_dataset.AddView(
+          utils::ViewNameFromTimestampNs(timestamp_ns), 0,
+          corner_dataset.TimestampS(v));
+      calib_index.Add(timestamp_ns, view_id);
+
+      for (size_t c = corner_dataset.ViewBegin(v);
+           c < corner_dataset.ViewEnd(v); ++c) {
+        recon_calib_dataset.AddObservation(view_id, corner_dataset.PointId(c),
+                                           corner_dataset.Corner(c));
       }
     }
     VideoCapture input_video;
     input_video.open(FLAGS_debug_video_path);
+    // containers without frame rate report 0, then the frame period is taken
+    // from the camera timestamps
+    double frame_period_s = 1.0 / 30.0;
+    const double video_fps = input_video.get(cv::CAP_PROP_FPS);
+    if (video_fps > 0.0) {
+      frame_period_s = 1.0 / video_fps;
+    } else if (cam_timestamps_s.size() > 1) {
+      std::vector<double> frame_spacings_s;
+      for (size_t i = 1; i < cam_timestamps_s.size(); ++i) {
+        frame_spacings_s.push_back(cam_timestamps_s[i] -
+                                   cam_timestamps_s[i - 1]);
+      }
+      frame_period_s =
+          std::max(1e-6, utils::MedianOfDoubleVec(frame_spacings_s));
+      LOG(WARNING) << "No frame rate in " << FLAGS_debug_video_path
+                   << ". Using the median camera frame period of "
+                   << frame_period_s << "s.";
+    }
+    utils::AsyncVisualizer visualizer("spline reprojection",
+                                      FLAGS_debug_video_output,
+                                      1.0 / frame_period_s, 32);
+    // the video timestamps are in ms, match to the closest view within
+    // half a frame
+    const int64_t max_frame_distance_ns = 0.5 * S_TO_NS * frame_period_s;
     int cnt_wrong = 0;
     int nr_frames = 0;
     while (true && nr_frames < 200) {
@@ -330,14 +357,14 @@ int main(int argc, char *argv[]) {
       const double timstamp_s =
           input_video.get(cv::CAP_PROP_POS_MSEC) * MS_TO_S;
 
-      const int64_t t_ns = timstamp_s * S_TO_NS;
+      const int64_t t_ns = utils::TimestampSToNs(timstamp_s);
 
       const theia::ViewId view_id_spline =
-          output_spline_recon.ViewIdFromName(std::to_string(t_ns));
+          spline_index.FindNearest(t_ns, max_frame_distance_ns);
       const theia::ViewId view_id_calib =
-          recon_calib_dataset.ViewIdFromName(std::to_string(t_ns));
+          calib_index.FindNearest(t_ns, max_frame_distance_ns);
 
-      if (view_id_spline == theia::kInvalidViewId &&
+      if (view_id_spline == theia::kInvalidViewId ||
           view_id_calib == theia::kInvalidViewId)
         continue;
 
@@ -367,10 +394,10 @@ int main(int argc, char *argv[]) {
                       " pixel",
                   cv::Point(20, 20), cv::FONT_HERSHEY_COMPLEX_SMALL, 1.0,
                   cv::Scalar(255, 0, 0));
-      cv::imshow("spline reprojection", image);
-      cv::waitKey(30);
+      visualizer.Show(image);
       ++nr_frames;
     }
+    visualizer.Close();
   }
   return 0;
 }
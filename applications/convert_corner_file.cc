@@ -0,0 +1,76 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <ios>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/io/corner_archive.h"
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/utils/json.h"
+
+using namespace OpenICC;
+
+DEFINE_string(input_corners, "",
+              "Corner file to convert (.uson, .oicc or .occz).");
+DEFINE_string(output_corners, "",
+              "Converted corner file. The format is selected by the ending "
+              "(.oicc for a corner stream, .occz for a compressed corner "
+              "archive, otherwise .uson).");
+DEFINE_bool(lossless_corners, false,
+            "Store the corners of a corner archive as doubles instead of "
+            "1/256 px fixed point.");
+DEFINE_double(start_s, -std::numeric_limits<double>::infinity(),
+              "Only convert views from this timestamp on.");
+DEFINE_double(end_s, std::numeric_limits<double>::infinity(),
+              "Only convert views up to this timestamp.");
+DEFINE_int32(every_kth_view, 1, "Only convert every k-th view.");
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  io::ViewSelection selection;
+  selection.start_s = FLAGS_start_s;
+  selection.end_s = FLAGS_end_s;
+  selection.every_kth_view = FLAGS_every_kth_view;
+  nlohmann::json scene_json;
+  CHECK(io::read_scene(FLAGS_input_corners, selection, scene_json))
+      << "Failed to load " << FLAGS_input_corners;
+
+  if (io::IsCornerArchivePath(FLAGS_output_corners)) {
+    CHECK(io::write_scene_corner_archive(scene_json, FLAGS_output_corners,
+                                         FLAGS_lossless_corners))
+        << "Failed to write " << FLAGS_output_corners;
+  } else if (io::IsCornerStreamPath(FLAGS_output_corners)) {
+    CHECK(io::write_scene_corner_stream(scene_json, FLAGS_output_corners))
+        << "Failed to write " << FLAGS_output_corners;
+  } else {
+    std::vector<std::uint8_t> v_bson = nlohmann::json::to_ubjson(scene_json);
+    std::ofstream output(FLAGS_output_corners,
+                         std::ios::out | std::ios::binary);
+    CHECK(output.is_open()) << "Failed to write " << FLAGS_output_corners;
+    output.write(reinterpret_cast<const char *>(v_bson.data()),
+                 v_bson.size() * sizeof(std::uint8_t));
+  }
+  LOG(INFO) << "Converted " << FLAGS_input_corners << " to "
+            << FLAGS_output_corners;
+  return 0;
+}
@@ -20,7 +20,7 @@
 
 #include "OpenCameraCalibrator/core/pose_estimator.h"
 #include "OpenCameraCalibrator/io/read_camera_calibration.h"
-#include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
@@ -42,8 +42,8 @@ int main(int argc, char *argv[]) {
   GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
   ::google::InitGoogleLogging(argv[0]);
 
-  nlohmann::json scene_json;
-  CHECK(read_scene_bson(FLAGS_input_corners, scene_json))
+  CornerDataset corner_dataset;
+  CHECK(corner_dataset.Load(FLAGS_input_corners))
       << "Failed to load " << FLAGS_input_corners;
 
   // read camera calibration
@@ -54,7 +54,7 @@ int main(int argc, char *argv[]) {
 
   LOG(INFO) << "Start pose estimation.\n";
   PoseEstimator pose_estimator;
-  pose_estimator.EstimatePosesFromJson(scene_json, camera);
+  pose_estimator.EstimatePoses(corner_dataset, camera);
   LOG(INFO) << "Finished pose estimation.\n";
   pose_estimator.OptimizeAllPoses();
   if (FLAGS_optimize_board_points) {
@@ -17,6 +17,7 @@
 #include <gflags/gflags.h>
 #include <ios>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -26,13 +27,26 @@
 
 using namespace cv;
 
-DEFINE_string(input_video, "", "Path to save charuco board to.");
+DEFINE_string(input_video, "",
+              "Path to the video or to a directory of images. Several comma "
+              "separated videos are extracted concurrently.");
+DEFINE_string(image_timestamps, "",
+              "Timestamp file for image directories. Each line contains an "
+              "image file name and its timestamp in seconds. If empty, "
+              "numeric file names are used as timestamps.");
+DEFINE_double(image_file_name_to_s, 1e-9,
+              "Scale from numeric image file names to seconds.");
+DEFINE_double(image_fps, 30.0,
+              "Frame rate of image directories. Used for timestamps if the "
+              "file names are not numeric.");
 DEFINE_string(board_type, "charuco", "Board type. (charuco, radon)");
 DEFINE_string(aruco_detector_params, "", "Path detector yaml.");
 DEFINE_double(downsample_factor, 2.0,
               "Downsample factor for images. I_new = 1/factor * I");
 DEFINE_string(save_corners_json_path, "",
-              "Where to save the recon dataset to.");
+              "Where to save the corners to. Files ending with .oicc are "
+              "written as corner stream while extracting, otherwise as .uson "
+              "at the end. One comma separated path per input video.");
 DEFINE_double(checker_square_length_m, 0.022,
               "Size of one square on the checkerbaord in [m]. Needed to only "
               "take far away poses!");
@@ -40,28 +54,197 @@ DEFINE_int32(num_squares_x, 9, "Number of squares in x.");
 DEFINE_int32(num_squares_y, 7, "Number of squares in y");
 DEFINE_int32(aruco_dict, cv::aruco::DICT_ARUCO_ORIGINAL,
              "Aruco dictionary id.");
+DEFINE_bool(reduced_dictionary, false,
+            "Only match markers against the dictionary entries that are on "
+            "the board. Faster and less false positive markers.");
 DEFINE_bool(recompute_corners, false, "If corners should be extracted again.");
 DEFINE_bool(verbose, false, "If more stuff should be printed");
+DEFINE_bool(write_timing_csv, false,
+            "Write the per frame durations of the extraction stages to "
+            "<save_corners_json_path>.timing.csv.");
+DEFINE_bool(coverage_map, false,
+            "Write the image and board pose coverage of the views to "
+            "<save_corners_json_path>.coverage.json.");
+DEFINE_double(min_cell_coverage, 0.0,
+              "Coverage target: fraction of the image grid cells that contain "
+              "corners (0 disables).");
+DEFINE_int32(min_pose_bins, 0,
+             "Coverage target: number of board tilt bins (of 13) that contain "
+             "views (0 disables).");
+DEFINE_int32(min_views_per_pose_bin, 1,
+             "Views a tilt bin needs to count for --min_pose_bins.");
+DEFINE_int32(coverage_sparse_stride, 0,
+             "Once the coverage targets are met, continue with every n-th "
+             "frame instead of stopping the extraction (0 stops).");
+DEFINE_string(verbose_video_path, "",
+              "Write the displayed corners to this video instead of showing "
+              "them in a window (headless).");
+DEFINE_int32(num_threads, 0,
+             "Number of corner detection threads. 0 uses all cores. With "
+             "several input videos this is the total number of threads, "
+             "decoders included.");
+DEFINE_int32(num_decoders, 1,
+             "Number of parallel video decoders. If > 1 the video is split "
+             "into keyframe aligned chunks that are decoded in parallel.");
+DEFINE_bool(coarse_to_fine, false,
+            "Detect the board on the downsampled image but refine the corners "
+            "on the full resolution image. Corners are saved in full "
+            "resolution.");
+DEFINE_string(min_frame_motion, "0",
+              "Skip frames whose mean absolute gray value difference to the "
+              "last extracted frame (on a thumbnail) is below this value. 0 "
+              "extracts all frames. Ignored when frames are decoded in "
+              "parallel (image sequences or --num_decoders > 1). "
+              "Either one value for all videos or one comma separated value "
+              "per input video.");
+DEFINE_string(max_extraction_rate_hz, "0",
+              "Maximum number of frames per second to extract. 0 extracts all "
+              "frames. Either one value for all videos or one comma separated "
+              "value per input video.");
+DEFINE_string(imu_camera_video, "",
+              "Input video used for the imu to camera calibration. All of its "
+              "frames are extracted regardless of --min_frame_motion and "
+              "--max_extraction_rate_hz.");
+DEFINE_bool(roi_tracking, false,
+            "Only search the board around its position in the previous "
+            "frame. Falls back to the full frame if too few corners are "
+            "found. Radon boards are tracked as saddle points and the "
+            "exhaustive search is only used to find the board again.");
+DEFINE_bool(batched_subpix, false,
+            "Refine all corners of a frame with the vectorized sub-pixel "
+            "refinement instead of cv::cornerSubPix.");
+DEFINE_double(min_sharpness, 0.0,
+              "Skip the detection in frames whose sharpness (variance of the "
+              "Laplacian on a thumbnail) is below this value. 0 disables the "
+              "check.");
+DEFINE_double(max_saturated_fraction, 1.0,
+              "Skip the detection in frames with a larger fraction of "
+              "saturated pixels.");
+DEFINE_bool(record_view_quality, false,
+            "Save the sharpness and saturated fraction of every view with its "
+            "corners.");
+DEFINE_int32(threshold_warmup_frames, 0,
+             "Narrow the adaptive threshold window sizes of the marker "
+             "detection to the ones that found markers in this many warm-up "
+             "frames. 0 always uses all window sizes.");
+DEFINE_bool(gray_decoding, false,
+            "Only decode the luminance plane of the video (needs OpenCV with "
+            "GStreamer). Falls back to BGR decoding.");
+DEFINE_bool(decoder_scaling, false,
+            "Downsample the frames while decoding (needs OpenCV with "
+            "GStreamer). Falls back to resizing the decoded frames.");
+DEFINE_bool(resume, false,
+            "Continue an interrupted corner stream extraction from its "
+            "checkpoint instead of starting over.");
+DEFINE_double(checkpoint_interval_s, 30.0,
+              "Seconds between checkpoints of corner stream extractions. 0 "
+              "disables checkpointing.");
 
 using namespace OpenICC;
 using namespace OpenICC::utils;
 using namespace OpenICC::core;
 using nlohmann::json;
 
+std::vector<std::string> SplitCommaList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
 int main(int argc, char *argv[]) {
   GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
   ::google::InitGoogleLogging(argv[0]);
 
-  if (DoesFileExist(FLAGS_save_corners_json_path) && !FLAGS_recompute_corners) {
-    LOG(INFO) << "Skipping corner extraction. Already extracted for: "
-              << FLAGS_input_video << "\n";
+  const std::vector<std::string> all_videos =
+      SplitCommaList(FLAGS_input_video);
+  const std::vector<std::string> all_save_paths =
+      SplitCommaList(FLAGS_save_corners_json_path);
+  std::vector<std::string> all_rates =
+      SplitCommaList(FLAGS_max_extraction_rate_hz);
+  if (all_rates.size() == 1) {
+    all_rates.resize(all_videos.size(), all_rates[0]);
+  }
+  std::vector<std::string> all_motions =
+      SplitCommaList(FLAGS_min_frame_motion);
+  if (all_motions.size() == 1) {
+    all_motions.resize(all_videos.size(), all_motions[0]);
+  }
+  if (all_videos.size() != all_save_paths.size() ||
+      all_videos.size() != all_rates.size() ||
+      all_videos.size() != all_motions.size()) {
+    LOG(ERROR) << "Need one save path, extraction rate and motion threshold "
+                  "per input video.";
+    return -1;
+  }
+
+  std::vector<std::string> videos, save_paths;
+  std::vector<double> max_extraction_rates_hz, min_frame_motions;
+  bool resume = false;
+  for (size_t i = 0; i < all_videos.size(); ++i) {
+    // an existing checkpoint means that the last extraction was interrupted
+    const bool interrupted = DoesFileExist(CheckpointPath(all_save_paths[i]));
+    if (DoesFileExist(all_save_paths[i]) && !interrupted &&
+        !FLAGS_recompute_corners) {
+      LOG(INFO) << "Skipping corner extraction. Already extracted for: "
+                << all_videos[i] << "\n";
+      continue;
+    }
+    resume |= interrupted;
+    videos.push_back(all_videos[i]);
+    save_paths.push_back(all_save_paths[i]);
+    double max_rate_hz = std::stod(all_rates[i]);
+    double min_motion = std::stod(all_motions[i]);
+    // the spline needs every frame of the imu to camera calibration video
+    if (all_videos[i] == FLAGS_imu_camera_video &&
+        (max_rate_hz > 0.0 || min_motion > 0.0)) {
+      LOG(WARNING) << "Extracting all frames of the imu camera video "
+                   << all_videos[i] << ".\n";
+      max_rate_hz = 0.0;
+      min_motion = 0.0;
+    }
+    max_extraction_rates_hz.push_back(max_rate_hz);
+    min_frame_motions.push_back(min_motion);
+  }
+  if (videos.empty()) {
     return 0;
   }
 
   BoardExtractor board_extractor;
-  if (FLAGS_verbose) {
+  if (!FLAGS_verbose_video_path.empty()) {
+    board_extractor.SetVerbosePlotVideo(FLAGS_verbose_video_path);
+  } else if (FLAGS_verbose) {
     board_extractor.SetVerbosePlot();
   }
+  board_extractor.SetNumThreads(FLAGS_num_threads);
+  board_extractor.SetTimingCsv(FLAGS_write_timing_csv);
+  CoverageTargets coverage_targets;
+  coverage_targets.min_cell_fraction = FLAGS_min_cell_coverage;
+  coverage_targets.min_pose_bins = FLAGS_min_pose_bins;
+  coverage_targets.min_views_per_pose_bin = FLAGS_min_views_per_pose_bin;
+  board_extractor.SetCoverageTracking(FLAGS_coverage_map, coverage_targets,
+                                      FLAGS_coverage_sparse_stride);
+  board_extractor.SetNumDecoders(FLAGS_num_decoders);
+  board_extractor.SetRoiTracking(FLAGS_roi_tracking);
+  board_extractor.SetCoarseToFine(FLAGS_coarse_to_fine);
+  board_extractor.SetGrayDecoding(FLAGS_gray_decoding);
+  board_extractor.SetThresholdWindowLocking(FLAGS_threshold_warmup_frames);
+  board_extractor.SetBatchedSubPixRefinement(FLAGS_batched_subpix);
+  board_extractor.SetFrameQualityGate(FLAGS_min_sharpness,
+                                      FLAGS_max_saturated_fraction);
+  board_extractor.SetViewQualityRecording(FLAGS_record_view_quality);
+  board_extractor.SetDecoderScaling(FLAGS_decoder_scaling);
+  board_extractor.SetImageSequenceTimestamps(
+      FLAGS_image_timestamps, FLAGS_image_file_name_to_s, FLAGS_image_fps);
+  board_extractor.SetCheckpointInterval(FLAGS_checkpoint_interval_s);
+  // videos without a checkpoint start from the first frame
+  board_extractor.SetResume(FLAGS_resume && resume &&
+                            !FLAGS_recompute_corners);
   BoardType board_type = StringToBoardType(FLAGS_board_type);
   if (board_type == BoardType::CHARUCO) {
     const float aruco_marker_length = FLAGS_checker_square_length_m / 2.0f;
@@ -69,14 +252,18 @@ int main(int argc, char *argv[]) {
     board_extractor.InitializeCharucoBoard(
         FLAGS_aruco_detector_params, aruco_marker_length,
         FLAGS_checker_square_length_m, FLAGS_num_squares_x, FLAGS_num_squares_y,
-        FLAGS_aruco_dict);
+        FLAGS_aruco_dict, FLAGS_reduced_dictionary);
   } else if (board_type == BoardType::RADON) {
      board_extractor.InitializeRadonBoard(FLAGS_checker_square_length_m, FLAGS_num_squares_x, FLAGS_num_squares_y);
   }
 
   LOG(INFO) << "Starting board extraction. This might take a while...";
-  board_extractor.ExtractVideoToJson(
-      FLAGS_input_video, FLAGS_save_corners_json_path, FLAGS_downsample_factor);
+  if (!board_extractor.ExtractVideosToJson(videos, save_paths,
+                                           FLAGS_downsample_factor,
+                                           max_extraction_rates_hz,
+                                           min_frame_motions)) {
+    return -1;
+  }
 
   return 0;
 }
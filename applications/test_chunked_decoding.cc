@@ -0,0 +1,174 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/core/board_extractor.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
+#include "OpenCameraCalibrator/io/read_mp4_index.h"
+
+// Checks that the keyframe aligned chunk decoding gives the same frames and
+// corners as a sequential run. Run it on a clip with B-frames, e.g.
+// ffmpeg -i in.mp4 -c:v libx264 -bf 3 -g 60 clip.mp4
+
+DEFINE_string(input_video, "", "MP4 clip to test, should contain B-frames.");
+DEFINE_bool(require_reordering, true,
+            "Fail if the clip has no composition offsets (B-frames).");
+DEFINE_int32(min_chunk_frames, 30, "Minimum number of frames per chunk.");
+DEFINE_string(board_type, "charuco",
+              "Board type in the clip (charuco, radon). Only used if "
+              "--aruco_detector_params or --board_type=radon is given.");
+DEFINE_string(aruco_detector_params, "", "Path detector yaml.");
+DEFINE_double(checker_square_length_m, 0.022, "Square size in [m].");
+DEFINE_int32(num_squares_x, 9, "Number of squares in x.");
+DEFINE_int32(num_squares_y, 7, "Number of squares in y");
+DEFINE_int32(aruco_dict, cv::aruco::DICT_ARUCO_ORIGINAL,
+             "Aruco dictionary id.");
+DEFINE_int32(num_decoders, 4, "Number of decoders of the chunked run.");
+
+using namespace OpenICC;
+
+struct DecodedFrame {
+  double timestamp_ms = 0.0;
+  cv::Scalar pixel_sum;
+};
+
+bool SameFrame(const DecodedFrame &a, const DecodedFrame &b) {
+  return std::abs(a.timestamp_ms - b.timestamp_ms) < 1e-3 &&
+         a.pixel_sum == b.pixel_sum;
+}
+
+// Decodes frames [start, end) of the video, seeking to start first
+std::vector<DecodedFrame> DecodeFrames(const int start, const int end) {
+  std::vector<DecodedFrame> frames;
+  cv::VideoCapture capture(FLAGS_input_video);
+  if (!capture.isOpened()) {
+    return frames;
+  }
+  if (start > 0) {
+    capture.set(cv::CAP_PROP_POS_FRAMES, start);
+  }
+  cv::Mat image;
+  for (int f = start; f < end && capture.read(image); ++f) {
+    DecodedFrame frame;
+    frame.timestamp_ms = capture.get(cv::CAP_PROP_POS_MSEC);
+    frame.pixel_sum = cv::sum(image);
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+bool ExtractCorners(const int num_decoders, const std::string &save_path,
+                    io::CornerDataset &dataset) {
+  core::BoardExtractor extractor;
+  extractor.SetNumThreads(2);
+  extractor.SetNumDecoders(num_decoders);
+  const core::BoardType board_type =
+      core::StringToBoardType(FLAGS_board_type);
+  if (board_type == core::BoardType::CHARUCO) {
+    extractor.InitializeCharucoBoard(
+        FLAGS_aruco_detector_params, FLAGS_checker_square_length_m / 2.0f,
+        FLAGS_checker_square_length_m, FLAGS_num_squares_x,
+        FLAGS_num_squares_y, FLAGS_aruco_dict, true);
+  } else {
+    extractor.InitializeRadonBoard(FLAGS_checker_square_length_m,
+                                   FLAGS_num_squares_x, FLAGS_num_squares_y);
+  }
+  std::remove(save_path.c_str());
+  return extractor.ExtractVideoToJson(FLAGS_input_video, save_path, 1.0) &&
+         dataset.Load(save_path);
+}
+
+int main(int argc, char *argv[]) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  io::MP4FrameIndex index;
+  CHECK(io::ReadMP4KeyframeIndex(FLAGS_input_video, index))
+      << "Could not read the frame index of " << FLAGS_input_video;
+  LOG(INFO) << index.nr_frames << " frames, " << index.keyframes.size()
+            << " keyframes, " << (index.reordered ? "with" : "without")
+            << " B-frames.";
+  CHECK(index.reordered || !FLAGS_require_reordering)
+      << "The clip has no B-frames.";
+
+  // every chunk decoded on its own has to match the sequential frames
+  const std::vector<DecodedFrame> sequential = DecodeFrames(0, index.nr_frames);
+  CHECK_EQ(static_cast<int>(sequential.size()), index.nr_frames)
+      << "Frame count of the index and the decoder differ.";
+  const auto chunks = io::KeyframeAlignedChunks(
+      index.nr_frames, index.keyframes, FLAGS_min_chunk_frames);
+  CHECK_GT(chunks.size(), 1u) << "The clip is too short to be split.";
+  int failures = 0;
+  for (const auto &chunk : chunks) {
+    const std::vector<DecodedFrame> frames =
+        DecodeFrames(chunk.first, chunk.second);
+    if (static_cast<int>(frames.size()) != chunk.second - chunk.first) {
+      LOG(ERROR) << "Chunk [" << chunk.first << ", " << chunk.second
+                 << ") decoded " << frames.size() << " frames.";
+      ++failures;
+      continue;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (!SameFrame(frames[i], sequential[chunk.first + i])) {
+        LOG(ERROR) << "Frame " << chunk.first + i << " of chunk ["
+                   << chunk.first << ", " << chunk.second
+                   << ") differs from the sequential frame.";
+        ++failures;
+        break;
+      }
+    }
+  }
+  LOG(INFO) << chunks.size() - failures << " of " << chunks.size()
+            << " chunks match the sequential decoding.";
+
+  // the corner output of both decoding paths has to be identical
+  if (!FLAGS_aruco_detector_params.empty() || FLAGS_board_type == "radon") {
+    io::CornerDataset sequential_corners, chunked_corners;
+    CHECK(ExtractCorners(1, "/tmp/test_chunked_decoding_1.uson",
+                         sequential_corners));
+    CHECK(ExtractCorners(FLAGS_num_decoders,
+                         "/tmp/test_chunked_decoding_n.uson",
+                         chunked_corners));
+    bool same = sequential_corners.NumViews() == chunked_corners.NumViews() &&
+                sequential_corners.NumCorners() ==
+                    chunked_corners.NumCorners();
+    for (size_t v = 0; same && v < sequential_corners.NumViews(); ++v) {
+      same = sequential_corners.TimestampNs(v) ==
+                 chunked_corners.TimestampNs(v) &&
+             sequential_corners.NumCorners(v) ==
+                 chunked_corners.NumCorners(v);
+    }
+    for (size_t c = 0; same && c < sequential_corners.NumCorners(); ++c) {
+      same = sequential_corners.PointId(c) == chunked_corners.PointId(c) &&
+             sequential_corners.Corner(c) == chunked_corners.Corner(c);
+    }
+    LOG(INFO) << sequential_corners.NumViews() << " views sequential, "
+              << chunked_corners.NumViews() << " views with "
+              << FLAGS_num_decoders << " decoders.";
+    if (!same) {
+      LOG(ERROR) << "Corners of the sequential and chunked run differ.";
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
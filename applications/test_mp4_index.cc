@@ -0,0 +1,163 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <glog/logging.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/io/read_mp4_index.h"
+
+// Writes MP4 files with synthetic sample tables and checks that
+// ReadMP4KeyframeIndex maps the keyframes to presentation order.
+
+using namespace OpenICC;
+
+namespace {
+
+void AppendU32(std::vector<uint8_t> &data, const uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    data.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+std::vector<uint8_t> MakeBox(const std::string &type,
+                             const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> box;
+  AppendU32(box, 8 + payload.size());
+  box.insert(box.end(), type.begin(), type.end());
+  box.insert(box.end(), payload.begin(), payload.end());
+  return box;
+}
+
+std::vector<uint8_t> Concat(const std::vector<std::vector<uint8_t>> &boxes) {
+  std::vector<uint8_t> data;
+  for (const auto &box : boxes) {
+    data.insert(data.end(), box.begin(), box.end());
+  }
+  return data;
+}
+
+// Full box with version 0 and a table of 32 bit values
+std::vector<uint8_t> MakeTableBox(const std::string &type,
+                                  const std::vector<uint32_t> &header,
+                                  const std::vector<uint32_t> &entries) {
+  std::vector<uint8_t> payload;
+  AppendU32(payload, 0);
+  for (const uint32_t value : header) {
+    AppendU32(payload, value);
+  }
+  for (const uint32_t value : entries) {
+    AppendU32(payload, value);
+  }
+  return MakeBox(type, payload);
+}
+
+// IBBP GOPs of gop_size frames. Every GOP is stored in decode order
+// I P B B P B B ..., each B-frame is presented before the P-frame that
+// precedes it in decode order.
+bool WriteClip(const std::string &path, const int nr_gops, const int gop_size,
+               const int edit_media_time) {
+  const int nr_samples = nr_gops * gop_size;
+  const uint32_t duration = 1000;
+  std::vector<uint32_t> ctts;
+  std::vector<uint32_t> sync_samples;
+  for (int g = 0; g < nr_gops; ++g) {
+    sync_samples.push_back(g * gop_size + 1);
+    // I-frame: shown after the B-frames that depend on the first P-frame
+    ctts.insert(ctts.end(), {1, duration});
+    for (int i = 1; i < gop_size; i += 3) {
+      // P-frame shown after the two following B-frames, B-frames shown
+      // one frame earlier than decoded
+      const int nr_b = std::min(2, gop_size - i - 1);
+      ctts.insert(ctts.end(), {1, (nr_b + 1) * duration});
+      for (int b = 0; b < nr_b; ++b) {
+        ctts.insert(ctts.end(), {1, 0});
+      }
+    }
+  }
+  std::vector<uint8_t> hdlr_payload(8, 0);
+  hdlr_payload.insert(hdlr_payload.end(), {'v', 'i', 'd', 'e'});
+  hdlr_payload.resize(24, 0);
+  const auto stbl = MakeBox(
+      "stbl",
+      Concat({MakeTableBox("stsz", {0, static_cast<uint32_t>(nr_samples)}, {}),
+              MakeTableBox("stts", {1}, {static_cast<uint32_t>(nr_samples),
+                                         duration}),
+              MakeTableBox("ctts", {static_cast<uint32_t>(ctts.size() / 2)},
+                           ctts),
+              MakeTableBox("stss",
+                           {static_cast<uint32_t>(sync_samples.size())},
+                           sync_samples)}));
+  const auto mdhd = MakeTableBox("mdhd", {0, 0, 30000, 0}, {});
+  std::vector<std::vector<uint8_t>> trak_boxes;
+  if (edit_media_time >= 0) {
+    trak_boxes.push_back(MakeBox(
+        "edts", MakeTableBox("elst", {1},
+                             {0, static_cast<uint32_t>(edit_media_time),
+                              0x10000})));
+  }
+  trak_boxes.push_back(MakeBox(
+      "mdia", Concat({mdhd, MakeBox("hdlr", hdlr_payload),
+                      MakeBox("minf", stbl)})));
+  const auto moov = MakeBox(
+      "moov", Concat({MakeTableBox("mvhd", {0, 0, 1000, 0}, {}),
+                      MakeBox("trak", Concat(trak_boxes))}));
+  const auto ftyp = MakeBox("ftyp", {'i', 's', 'o', 'm', 0, 0, 0, 0});
+  std::ofstream file(path, std::ios::binary);
+  const auto data = Concat({ftyp, moov});
+  file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  return file.good();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ::google::InitGoogleLogging(argv[0]);
+  const std::string path = "/tmp/test_mp4_index.mp4";
+  int failures = 0;
+
+  // B-frames: the keyframes stay at the GOP starts in presentation order
+  CHECK(WriteClip(path, 4, 10, -1));
+  io::MP4FrameIndex index;
+  CHECK(io::ReadMP4KeyframeIndex(path, index));
+  if (index.nr_frames != 40 || !index.reordered ||
+      index.keyframes != std::vector<int>({0, 10, 20, 30})) {
+    LOG(ERROR) << "Wrong index of the B-frame clip.";
+    ++failures;
+  }
+
+  // an edit list that starts at the I-frame presentation time drops nothing
+  // before it, one that starts a frame later drops the first frame
+  CHECK(WriteClip(path, 4, 10, 1000));
+  CHECK(io::ReadMP4KeyframeIndex(path, index));
+  if (index.nr_frames != 40 ||
+      index.keyframes != std::vector<int>({0, 10, 20, 30})) {
+    LOG(ERROR) << "Wrong index of the clip with a B-frame edit list.";
+    ++failures;
+  }
+  CHECK(WriteClip(path, 4, 10, 2000));
+  CHECK(io::ReadMP4KeyframeIndex(path, index));
+  if (index.nr_frames != 39 ||
+      index.keyframes != std::vector<int>({9, 19, 29})) {
+    LOG(ERROR) << "Wrong index of the clip with a cutting edit list.";
+    ++failures;
+  }
+  std::remove(path.c_str());
+  LOG_IF(INFO, failures == 0) << "MP4 index tests passed.";
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+#include <random>
+#include <vector>
+
+#include "OpenCameraCalibrator/core/subpixel_refinement.h"
+
+// Compares RefineCornersSubPix with cv::cornerSubPix on synthetic
+// checkerboards, for windows narrower and wider than the SIMD registers.
+
+using namespace OpenICC;
+
+namespace {
+
+const int kSquareSizePx = 24;
+const int kSupersampling = 8;
+//! Maximum distance between the corners of both refinements
+const float kTolerancePx = 0.02f;
+
+// Renders a rotated and shifted checkerboard at a higher resolution and
+// downsamples it, so the corners lie at sub-pixel positions
+cv::Mat RenderCheckerboard(const double angle, const cv::Point2d &shift,
+                           std::vector<cv::Point2f> &corners) {
+  const int nr_squares = 6;
+  const int size = (nr_squares + 2) * kSquareSizePx;
+  const double s = kSupersampling;
+  const double ca = std::cos(angle), sa = std::sin(angle);
+  const cv::Point2d center(0.5 * size, 0.5 * size);
+
+  cv::Mat hires(size * kSupersampling, size * kSupersampling, CV_8U);
+  for (int y = 0; y < hires.rows; ++y) {
+    for (int x = 0; x < hires.cols; ++x) {
+      const cv::Point2d p((x + 0.5) / s - 0.5 - center.x - shift.x,
+                          (y + 0.5) / s - 0.5 - center.y - shift.y);
+      const double u = (ca * p.x + sa * p.y) / kSquareSizePx;
+      const double v = (-sa * p.x + ca * p.y) / kSquareSizePx;
+      const bool black =
+          (static_cast<int>(std::floor(u)) + static_cast<int>(std::floor(v))) %
+              2 ==
+          0;
+      hires.at<uchar>(y, x) = black ? 40 : 215;
+    }
+  }
+  cv::Mat image;
+  cv::resize(hires, image, cv::Size(size, size), 0, 0, cv::INTER_AREA);
+
+  corners.clear();
+  for (int i = -nr_squares / 2 + 1; i < nr_squares / 2; ++i) {
+    for (int j = -nr_squares / 2 + 1; j < nr_squares / 2; ++j) {
+      const double u = j * kSquareSizePx, v = i * kSquareSizePx;
+      corners.push_back(cv::Point2f(
+          static_cast<float>(ca * u - sa * v + center.x + shift.x),
+          static_cast<float>(sa * u + ca * v + center.y + shift.y)));
+    }
+  }
+  return image;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ::google::InitGoogleLogging(argv[0]);
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> angle_dist(0.0, CV_PI / 2.0);
+  std::uniform_real_distribution<double> shift_dist(-0.5, 0.5);
+  std::uniform_real_distribution<float> init_dist(-1.5f, 1.5f);
+  const cv::TermCriteria criteria(
+      cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 0.01);
+
+  int failures = 0;
+  for (const int half_win : {3, 5, 11}) {
+    float max_diff = 0.f;
+    for (int n = 0; n < 5; ++n) {
+      std::vector<cv::Point2f> gt_corners;
+      cv::Mat image = RenderCheckerboard(
+          angle_dist(rng), cv::Point2d(shift_dist(rng), shift_dist(rng)),
+          gt_corners);
+      cv::GaussianBlur(image, image, cv::Size(0, 0), 1.0);
+
+      std::vector<cv::Point2f> opencv_corners = gt_corners;
+      for (auto &pt : opencv_corners) {
+        pt += cv::Point2f(init_dist(rng), init_dist(rng));
+      }
+      std::vector<cv::Point2f> refined_corners = opencv_corners;
+      cv::cornerSubPix(image, opencv_corners, cv::Size(half_win, half_win),
+                       cv::Size(-1, -1), criteria);
+      core::RefineCornersSubPix(image, refined_corners, half_win,
+                                criteria.maxCount, criteria.epsilon);
+      for (size_t i = 0; i < refined_corners.size(); ++i) {
+        const cv::Point2f diff = refined_corners[i] - opencv_corners[i];
+        max_diff = std::max(max_diff, std::hypot(diff.x, diff.y));
+      }
+    }
+    if (max_diff > kTolerancePx) {
+      LOG(ERROR) << "Half window " << half_win << ": corners differ by up to "
+                 << max_diff << "px from cv::cornerSubPix.";
+      ++failures;
+    }
+  }
+
+  LOG_IF(INFO, failures == 0) << "Sub-pixel refinement tests passed.";
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace core {
+
+//! Coverage that is enough for a calibration. A target of 0 is always met.
+struct CoverageTargets {
+  //! Fraction of the image grid cells that contain corners
+  double min_cell_fraction = 0.0;
+  //! Number of board pose bins with at least min_views_per_pose_bin views
+  int min_pose_bins = 0;
+  int min_views_per_pose_bin = 1;
+
+  bool Enabled() const { return min_cell_fraction > 0.0 || min_pose_bins > 0; }
+};
+
+//! Incrementally bins the detected corners by image region and the views by
+//! board tilt. The tilt is computed from the board to image homography with an
+//! assumed focal length of the image width, which is only meant to tell
+//! different board poses apart. Views are binned into one frontal bin and
+//! kTiltBands x kTiltDirections tilted bins.
+class BoardCoverage {
+public:
+  //! board_pts: planar board points (z = 0) of every board point id
+  //! grid_cols: number of grid cells along the image width, the number of
+  //! rows follows from the aspect ratio
+  BoardCoverage(const cv::Size &image_size,
+                const std::map<int, cv::Point2f> &board_pts,
+                const int grid_cols = 8);
+
+  //! Adds the corners of a view. Returns the pose bin of the view, -1 if it
+  //! has too few corners to estimate the pose.
+  int AddView(const aligned_vector<Eigen::Vector2d> &corners,
+              const std::vector<int> &ids);
+
+  //! Fraction of grid cells that contain at least one corner
+  double CellFraction() const;
+
+  //! Number of pose bins with at least min_views views
+  int NumPoseBins(const int min_views) const;
+
+  bool TargetsMet(const CoverageTargets &targets) const;
+
+  int NumViews() const { return num_views_; }
+
+  //! Corner counts per grid cell and view counts per pose bin
+  nlohmann::json ToJson() const;
+
+  static const int kTiltBands = 3;
+  static const int kTiltDirections = 4;
+  static const int kNumPoseBins = 1 + kTiltBands * kTiltDirections;
+
+private:
+  cv::Size image_size_;
+  std::map<int, cv::Point2f> board_pts_;
+  int grid_cols_;
+  int grid_rows_;
+  std::vector<int> cell_corners_;
+  std::vector<int> pose_bin_views_;
+  int num_views_ = 0;
+};
+
+} // namespace core
+} // namespace OpenICC
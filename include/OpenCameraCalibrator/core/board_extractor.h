@@ -19,10 +19,14 @@
 #include <opencv2/aruco/charuco.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "OpenCameraCalibrator/core/board_coverage.h"
+#include "OpenCameraCalibrator/core/extraction_timing.h"
+#include "OpenCameraCalibrator/core/radon_board_tracker.h"
 #include "OpenCameraCalibrator/utils/types.h"
 
 #include <algorithm>
 #include <dirent.h>
+#include <memory>
 #include <vector>
 
 namespace OpenICC {
@@ -38,6 +42,88 @@ inline BoardType StringToBoardType(const std::string &board_type) {
   }
 }
 
+//! Statistics of the ROI tracking
+struct RoiTrackingStats {
+  int roi_attempts = 0;
+  int roi_hits = 0;
+  double roi_time_ms = 0.0;
+  int full_frames = 0;
+  double full_time_ms = 0.0;
+};
+
+//! Adaptive threshold window sizes that find markers. Recorded during a
+//! warm-up, after which the window size sweep is narrowed to them.
+struct ThresholdWindowLock {
+  //! Markers found with each window size of the full sweep during warm-up
+  std::vector<int> markers_per_window;
+  //! Number of frames since the warm-up started
+  int warmup_frames = 0;
+  //! Number of warm-up frames with markers
+  int warmup_detections = 0;
+  //! If the sweep is narrowed
+  bool locked = false;
+  //! Running average of frames with markers since locking
+  double detection_rate = 0.0;
+  //! Rate of frames with markers during warm-up
+  double warmup_detection_rate = 0.0;
+};
+
+//! Aruco detection state. Detection threads each own a copy of it.
+struct DetectorState {
+  //! Aruco board detector parameters
+  cv::Ptr<cv::aruco::DetectorParameters> detector_params;
+  //! Aruco board dictionary
+  cv::Ptr<cv::aruco::Dictionary> dictionary;
+  //! Charuco board
+  cv::Ptr<cv::aruco::CharucoBoard> charucoboard;
+  //! Aruco board
+  cv::Ptr<cv::aruco::Board> board;
+
+  //! Index of the frame that is currently processed
+  int frame_idx = 0;
+  //! Frame index of the last detection used for tracking (-1 if none)
+  int last_tracked_frame_idx = -1;
+  //! Bounding box of the board markers in the last tracked frame
+  cv::Rect2f last_board_bbox;
+  //! Number of charuco corners in the last tracked frame
+  int last_num_tracked_corners = 0;
+  //! ROI tracking statistics
+  RoiTrackingStats tracking_stats;
+  //! Stage durations of the current frame
+  StageTimes stage_ms{};
+
+  //! Smallest marker side length in the last frame in detection image
+  //! pixels (0 if no marker was found). Used by the ArUco3 detection to skip
+  //! thresholding at scales that can not contain a marker.
+  float last_min_marker_side = 0.f;
+  //! Frame index of last_min_marker_side
+  int last_marker_frame_idx = -1;
+
+  //! Narrowed adaptive threshold window sweep
+  ThresholdWindowLock threshold_lock;
+
+  //! Radon corners of the last tracked frame in detection image coordinates
+  std::vector<cv::Point2f> last_radon_corners;
+  //! Meta data of the Radon board found by cv::findChessboardCornersSB
+  cv::Mat last_radon_meta;
+};
+
+//! Extraction progress of a corner stream is checkpointed to this file
+inline std::string CheckpointPath(const std::string &save_path) {
+  return save_path + ".ckpt";
+}
+
+//! Per frame stage durations of an extraction are written to this file
+inline std::string TimingCsvPath(const std::string &save_path) {
+  return save_path + ".timing.csv";
+}
+
+//! Coverage of the image and the board poses of an extraction is written to
+//! this file
+inline std::string CoveragePath(const std::string &save_path) {
+  return save_path + ".coverage.json";
+}
+
 class BoardExtractor {
 public:
   BoardExtractor();
@@ -47,15 +133,36 @@ public:
                     aligned_vector<Eigen::Vector2d> &corners,
                     std::vector<int> &object_pt_ids);
 
-  //! Extracts a board from a video file to a json file and saves it to disk
+  //! Extracts a board using a thread local detector state
+  bool ExtractBoard(const cv::Mat &image, DetectorState &state,
+                    aligned_vector<Eigen::Vector2d> &corners,
+                    std::vector<int> &object_pt_ids);
+
+  //! Extracts a board from a video file or a directory of images to a json
+  //! file and saves it to disk
   bool ExtractVideoToJson(const std::string& video_path,
                           const std::string& save_path,
                           const double img_downsample_factor);
 
+  //! Extracts boards from several videos concurrently. The threads of
+  //! SetNumThreads, decoder threads included, are split between the videos
+  //! proportional to their number of frames.
+  //! max_extraction_rates_hz and min_motions optionally override the frame
+  //! skipping per video (see SetFrameSkipping).
+  bool ExtractVideosToJson(
+      const std::vector<std::string> &video_paths,
+      const std::vector<std::string> &save_paths,
+      const double img_downsample_factor,
+      const std::vector<double> &max_extraction_rates_hz = {},
+      const std::vector<double> &min_motions = {});
+
   //! Initializes a Charuco board
+  //! If reduced_dictionary is set, markers are only matched against the
+  //! dictionary entries that are on the board.
   bool InitializeCharucoBoard(std::string path_to_detector_params,
                               float marker_length, float square_length,
-                              int squaresX, int squaresY, int dictionaryId);
+                              int squaresX, int squaresY, int dictionaryId,
+                              bool reduced_dictionary = false);
 
   //! Initializes a Radon checkerboard
   bool InitializeRadonBoard(float square_length, int squaresX, int squaresY);
@@ -68,7 +175,169 @@ public:
   //! Set verbose plot
   void SetVerbosePlot() { verbose_plot_ = true; }
 
+  //! Writes the verbose plot to a video file instead of displaying it
+  //! (headless). Implies SetVerbosePlot.
+  void SetVerbosePlotVideo(const std::string &video_path) {
+    verbose_plot_ = true;
+    verbose_plot_video_ = video_path;
+  }
+
+  //! Number of detection threads. 0 uses all available cores.
+  void SetNumThreads(const int num_threads);
+
+  //! Number of parallel video decoders. More than one decoder splits the
+  //! video into keyframe aligned chunks (GOPs) that are decoded in parallel.
+  void SetNumDecoders(const int num_decoders);
+
+  //! Detect the board only inside a region around the previous detection.
+  //! The region is the last board bounding box enlarged by roi_margin times
+  //! its size. Falls back to the full frame if too few corners are found.
+  //! Radon board corners are tracked as saddle points around their previous
+  //! positions, the exhaustive board search is only used for re-acquisition.
+  void SetRoiTracking(const bool roi_tracking, const double roi_margin = 0.25);
+
+  //! Skip frames before detection. min_motion is the minimum mean absolute
+  //! gray value difference of a thumbnail to the last extracted frame and
+  //! max_extraction_rate_hz limits the number of extracted frames per second.
+  //! 0 disables the respective check, so all frames are extracted by default.
+  //! The rate limit keeps at most one frame per 1 / max_extraction_rate_hz
+  //! time slot for all decoders of a video together. With several decoders
+  //! the motion is compared within each decoded chunk.
+  void SetFrameSkipping(const double min_motion,
+                        const double max_extraction_rate_hz);
+
+  //! Periodically write the extraction progress of corner stream outputs to
+  //! CheckpointPath(save_path). 0 disables checkpoints.
+  void SetCheckpointInterval(const double checkpoint_interval_s) {
+    checkpoint_interval_s_ = checkpoint_interval_s;
+  }
+
+  //! Continue an interrupted extraction from its checkpoint
+  void SetResume(const bool resume) { resume_ = resume; }
+
+  //! Detect markers on the image downsampled by img_downsample_factor but
+  //! refine the corners on the full resolution image. Corners and image size
+  //! are then written in full resolution.
+  void SetCoarseToFine(const bool coarse_to_fine);
+
+  //! Only decode the luminance plane of videos. Detection does not need
+  //! color, this skips the YUV to BGR conversion of the decoder.
+  void SetGrayDecoding(const bool gray_decoding) {
+    gray_decoding_ = gray_decoding;
+  }
+
+  //! Timestamps of image sequences. They are read from timestamps_path if
+  //! given, otherwise from numeric file names (times file_name_to_s) or
+  //! computed from fps, which is also saved as camera fps.
+  void SetImageSequenceTimestamps(const std::string &timestamps_path,
+                                  const double file_name_to_s,
+                                  const double fps) {
+    image_timestamps_path_ = timestamps_path;
+    image_file_name_to_s_ = file_name_to_s;
+    image_fps_ = fps;
+  }
+
+  //! Records which adaptive threshold window sizes find markers in the first
+  //! warmup_frames frames with markers of every detection thread and narrows
+  //! the window size sweep to them. The full sweep is restored if the detection rate
+  //! drops. 0 disables locking.
+  void SetThresholdWindowLocking(const int warmup_frames) {
+    threshold_warmup_frames_ = warmup_frames;
+  }
+
+  //! Skips the detection in frames whose sharpness (variance of the
+  //! Laplacian on a thumbnail) is below min_sharpness or that have more than
+  //! max_saturated_fraction saturated pixels. Skipped frames are logged with
+  //! their quality.
+  void SetFrameQualityGate(const double min_sharpness,
+                           const double max_saturated_fraction) {
+    min_sharpness_ = min_sharpness;
+    max_saturated_fraction_ = max_saturated_fraction;
+  }
+
+  //! Save the quality of every view with its corners. The quality is only
+  //! measured if this or the quality gate is on.
+  void SetViewQualityRecording(const bool record_view_quality) {
+    record_view_quality_ = record_view_quality;
+  }
+
+  //! Refine all corners of a frame with the SIMD sub-pixel refinement instead
+  //! of cv::cornerSubPix. Charuco corners are then interpolated with an own
+  //! implementation of the local homography interpolation.
+  void SetBatchedSubPixRefinement(const bool batched_subpix) {
+    batched_subpix_ = batched_subpix;
+  }
+
+  //! Enables or disables the ArUco3 detection of the detector parameters.
+  //! Needs OpenCV >= 4.5.3.
+  void SetAruco3Detection(const bool use_aruco3);
+
+  //! Let the decoder downsample the frames instead of resizing the full
+  //! resolution frames afterwards. Not used for coarse to fine detection.
+  void SetDecoderScaling(const bool decoder_scaling) {
+    decoder_scaling_ = decoder_scaling;
+  }
+
+  //! Writes the stage durations of every frame to a csv file next to the
+  //! output (see TimingCsvPath)
+  void SetTimingCsv(const bool write_timing_csv) {
+    write_timing_csv_ = write_timing_csv;
+  }
+
+  //! Tracks how well the views cover the image and the board poses
+  //! (BoardCoverage) and writes the coverage map to CoveragePath. Once the
+  //! targets are met the extraction stops, or continues with only every
+  //! sparse_stride-th frame if sparse_stride > 1.
+  void SetCoverageTracking(const bool write_coverage_map,
+                           const CoverageTargets &targets,
+                           const int sparse_stride = 0) {
+    coverage_map_ = write_coverage_map;
+    coverage_targets_ = targets;
+    coverage_sparse_stride_ = sparse_stride;
+  }
+
+  //! Deep copy of the detector state for a detection thread
+  DetectorState CloneDetectorState() const;
+
 private:
+  //! Extracts a board from a video with num_threads detection threads
+  bool ExtractVideoToJson(const std::string &video_path,
+                          const std::string &save_path,
+                          const double img_downsample_factor,
+                          const int num_threads, const double max_rate_hz,
+                          const double min_motion, const bool plot);
+
+  //! Detects a board on detect_image and refines the corners on image.
+  //! detect_image is image downsampled by detect_scale.
+  bool ExtractBoard(const cv::Mat &detect_image, const cv::Mat &image,
+                    const double detect_scale, DetectorState &state,
+                    aligned_vector<Eigen::Vector2d> &corners,
+                    std::vector<int> &object_pt_ids);
+
+  //! Detects markers on detect_image restricted to roi (in detect_image
+  //! coordinates) and interpolates the charuco corners on image
+  bool DetectCharucoCorners(const cv::Mat &detect_image, const cv::Mat &image,
+                            const double detect_scale, const cv::Rect &roi,
+                            DetectorState &state,
+                            std::vector<cv::Point2f> &charuco_corners,
+                            std::vector<int> &charuco_ids,
+                            cv::Rect2f &board_bbox);
+
+  //! Counts the markers that each window size of the full sweep finds
+  //! during the warm-up of the threshold window lock
+  void CountMarkersPerThresholdWindow(const cv::Mat &image,
+                                      DetectorState &state) const;
+
+  //! Locks or unlocks the threshold window sweep of state. Called once per
+  //! frame after the detection.
+  void UpdateThresholdWindowLock(const bool found_markers,
+                                 DetectorState &state) const;
+
+  //! Predicts the board region from the last detection
+  cv::Rect PredictBoardRoi(const cv::Rect2f &last_board_bbox,
+                           const int frame_gap,
+                           const cv::Size &image_size) const;
+
   //! Board type
   BoardType board_type_;
 
@@ -90,6 +359,8 @@ private:
   cv::Size radon_pattern_size_;
   //! radon board pt continuous index
   std::vector<int> radon_board_indices_;
+  //! tracks radon boards between frames
+  std::unique_ptr<RadonBoardTracker> radon_tracker_;
 
   //! if a board is already initialized
   bool board_initialized_ = false;
@@ -97,8 +368,73 @@ private:
   //! square size in meter
   double square_length_m_;
 
+  //! expected relative marker size change between frames (ArUco3)
+  double camera_motion_speed_ = 0.0;
+
+  //! refine corners with RefineCornersSubPix
+  bool batched_subpix_ = false;
+
+  //! write the per frame stage durations to a csv file
+  bool write_timing_csv_ = false;
+
+  //! write the coverage map, also done if coverage targets are set
+  bool coverage_map_ = false;
+  //! coverage that ends the extraction
+  CoverageTargets coverage_targets_;
+  //! frame stride after the coverage targets were met (<= 1 stops)
+  int coverage_sparse_stride_ = 0;
+
+  //! minimum sharpness of frames that go to the detection
+  double min_sharpness_ = 0.0;
+  //! maximum fraction of saturated pixels of frames that go to the detection
+  double max_saturated_fraction_ = 1.0;
+  //! save the view quality with the corners
+  bool record_view_quality_ = false;
+
+  //! frames used to find the useful threshold window sizes (0 disables)
+  int threshold_warmup_frames_ = 0;
+
   //! display extracted corners
   bool verbose_plot_ = false;
+  //! if set, the displayed corners are encoded to this video
+  std::string verbose_plot_video_;
+
+  //! number of detection threads
+  int num_threads_ = 1;
+
+  //! number of parallel video decoders
+  int num_decoders_ = 1;
+
+  //! restrict the marker search to the region of the last detection
+  bool roi_tracking_ = false;
+  //! enlargement of the tracked board region relative to its size
+  double roi_margin_ = 0.25;
+
+  //! detect on a coarse image, refine on the full resolution image
+  bool coarse_to_fine_ = false;
+
+  //! decode gray images instead of BGR
+  bool gray_decoding_ = false;
+
+  //! downsample frames in the decoder
+  bool decoder_scaling_ = false;
+
+  //! timestamp file of image sequences
+  std::string image_timestamps_path_ = "";
+  //! scale from numeric image file names to seconds
+  double image_file_name_to_s_ = 1e-9;
+  //! frame rate of image sequences
+  double image_fps_ = 30.0;
+
+  //! minimum thumbnail difference to the last extracted frame
+  double min_motion_ = 0.0;
+  //! maximum number of extracted frames per second
+  double max_extraction_rate_hz_ = 0.0;
+
+  //! seconds between two checkpoints
+  double checkpoint_interval_s_ = 30.0;
+  //! resume from the last checkpoint
+  bool resume_ = false;
 };
 
 }
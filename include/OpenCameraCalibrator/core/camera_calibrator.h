@@ -18,6 +18,7 @@
 #include <theia/sfm/reconstruction.h>
 #include <theia/solvers/ransac.h>
 
+#include "OpenCameraCalibrator/io/corner_dataset.h"
 #include "OpenCameraCalibrator/utils/json.h"
 
 namespace OpenICC {
@@ -33,6 +34,9 @@ public:
   bool CalibrateCameraFromJson(const nlohmann::json &scene_json,
                                const std::string &output_path);
 
+  bool CalibrateCamera(const io::CornerDataset &dataset,
+                       const std::string &output_path);
+
   bool WriteCalibration(const std::string &output_path);
 
   void RemoveViewsReprojError(const double max_reproj_error = 2.0);
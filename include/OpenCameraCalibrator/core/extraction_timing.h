@@ -0,0 +1,94 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace OpenICC {
+namespace core {
+
+//! Stages of the corner extraction that are timed for every frame
+enum class ExtractionStage {
+  DECODE = 0,
+  RESIZE,
+  QUALITY,
+  DETECT_MARKERS,
+  THRESHOLD_WARMUP,
+  REFINE_MARKERS,
+  INTERPOLATE_CORNERS,
+  CHESSBOARD_DETECTION,
+  REFINE_CORNERS,
+  OUTPUT,
+  NUM_STAGES
+};
+
+const int kNumExtractionStages =
+    static_cast<int>(ExtractionStage::NUM_STAGES);
+
+//! Duration of every stage of one frame in milliseconds
+using StageTimes = std::array<float, kNumExtractionStages>;
+
+const char *ExtractionStageName(const ExtractionStage stage);
+
+//! Adds the time between construction and destruction to a stage
+class ScopedStageTimer {
+public:
+  ScopedStageTimer(StageTimes &times, const ExtractionStage stage)
+      : times_(times), stage_(stage),
+        start_(std::chrono::steady_clock::now()) {}
+  ~ScopedStageTimer() {
+    times_[static_cast<int>(stage_)] +=
+        std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - start_)
+            .count();
+  }
+
+private:
+  StageTimes &times_;
+  const ExtractionStage stage_;
+  const std::chrono::steady_clock::time_point start_;
+};
+
+//! Collects the stage times of all frames of an extraction. Not thread safe,
+//! frames are added by the writer of the extraction pipeline.
+class ExtractionTimings {
+public:
+  void AddFrame(const int video_frame, const double timestamp_s,
+                const bool found_board, const StageTimes &stage_ms);
+
+  //! Logs p50 / p95 / max of every stage over the frames the stage ran on,
+  //! the throughput and the detection rate
+  void LogSummary(const double elapsed_s) const;
+
+  //! One line per frame with the duration of every stage in milliseconds
+  bool WriteCsv(const std::string &csv_path) const;
+
+  size_t NumFrames() const { return frames_.size(); }
+
+private:
+  struct FrameTiming {
+    int video_frame;
+    double timestamp_s;
+    bool found_board;
+    StageTimes stage_ms;
+  };
+  std::vector<FrameTiming> frames_;
+};
+
+} // namespace core
+} // namespace OpenICC
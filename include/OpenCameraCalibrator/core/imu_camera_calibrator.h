@@ -51,6 +51,8 @@ public:
                   const bool fix_T_i_c,
                   const bool fix_line_delay);
 
+  //! Adds one view with the spline pose per camera timestamp. The view
+  //! timestamps are in ns.
   void ToTheiaReconDataset(theia::Reconstruction &output_recon);
 
   void ClearSpline();
@@ -20,6 +20,7 @@
 #include <theia/sfm/reconstruction.h>
 #include <theia/solvers/ransac.h>
 
+#include "OpenCameraCalibrator/io/corner_dataset.h"
 #include "OpenCameraCalibrator/utils/json.h"
 #include "OpenCameraCalibrator/utils/types.h"
 
@@ -46,6 +47,10 @@ public:
                              const theia::Camera camera,
                              const double max_reproj_error = 3.0);
 
+  bool EstimatePoses(const io::CornerDataset &dataset,
+                     const theia::Camera camera,
+                     const double max_reproj_error = 3.0);
+
   void GetPoseDataset(theia::Reconstruction &pose_dataset) {
     pose_dataset = pose_dataset_;
   }
@@ -0,0 +1,65 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace OpenICC {
+namespace core {
+
+//! Tracks the inner corners of a Radon checkerboard from one frame to the
+//! next. Every corner is searched as saddle point of the image intensity
+//! around its previous position. The result is only accepted if the grid is
+//! still regular and the cell colors agree with the meta data (cell colors
+//! and marker layout) of cv::findChessboardCornersSB, so the corner ordering
+//! of the previous frame stays valid.
+class RadonBoardTracker {
+public:
+  //! pattern_size: inner corners per row and column
+  explicit RadonBoardTracker(const cv::Size &pattern_size);
+
+  //! Finds the corners of the board in image. prev_corners are the corners of
+  //! a previous frame in the order of cv::findChessboardCornersSB and meta its
+  //! meta data. The grid size is taken from meta, which also covers boards
+  //! found larger than pattern_size with CALIB_CB_LARGER. Returns false if
+  //! the board could not be tracked.
+  bool Track(const cv::Mat &image, const std::vector<cv::Point2f> &prev_corners,
+             const cv::Mat &meta, std::vector<cv::Point2f> &corners) const;
+
+private:
+  //! Most pronounced saddle point within search_radius around prediction
+  bool FindSaddlePoint(const cv::Mat &gray, const cv::Point2f &prediction,
+                       const float search_radius, cv::Point2f &saddle) const;
+
+  //! Checks that every corner lies between its grid neighbours
+  bool CheckGrid(const std::vector<cv::Point2f> &corners,
+                 const cv::Size &grid_size) const;
+
+  //! Checks the cell colors against the meta data of the board
+  bool CheckCellColors(const cv::Mat &gray,
+                       const std::vector<cv::Point2f> &corners,
+                       const cv::Mat &meta, const cv::Size &grid_size) const;
+
+  //! Distance to the closest grid neighbour of every corner
+  std::vector<float>
+  NeighbourDistances(const std::vector<cv::Point2f> &corners,
+                     const cv::Size &grid_size) const;
+
+  cv::Size pattern_size_;
+};
+
+} // namespace core
+} // namespace OpenICC
@@ -0,0 +1,36 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace OpenICC {
+namespace core {
+
+//! Refines the positions of chessboard corners (saddle points) in a gray
+//! image. Same model as cv::cornerSubPix, i.e. every corner moves to the point
+//! that is orthogonal to all image gradients in its window. The corners are
+//! refined one after the other, the gradient sums of a window row are
+//! accumulated with SIMD instructions (OpenCV >= 4.8) if the window is at
+//! least as wide as a vector register. Corners that do not converge within
+//! half_win of their initial position keep the initial position.
+//! half_win: half of the window size (window is 2 * half_win + 1)
+void RefineCornersSubPix(const cv::Mat &gray, std::vector<cv::Point2f> &corners,
+                         const int half_win, const int max_iterations = 20,
+                         const double epsilon = 0.01);
+
+} // namespace core
+} // namespace OpenICC
@@ -0,0 +1,55 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/utils/json.h"
+
+// Helpers shared by the binary corner formats (corner stream, corner
+// archive). Only used by their implementations.
+
+namespace OpenICC {
+namespace io {
+
+// we only run on little endian machines, so values are written as they are
+template <typename T> void WritePod(std::ofstream &file, const T &value) {
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> bool ReadPod(std::ifstream &file, T &value) {
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+//! Writes the board description: i32 board type | f64 square size [m] |
+//! f64 fps | i32 image width | i32 image height | u32 nr scene pts |
+//! nr scene pts x (i32 id | f64 x | f64 y | f64 z)
+void WriteBoardHeader(std::ofstream &file, const CornerStreamHeader &header);
+
+//! Reads the board description written by WriteBoardHeader
+bool ReadBoardHeader(std::ifstream &file, CornerStreamHeader &header);
+
+//! Board description to the keys of the .uson corner json
+void BoardHeaderToJson(const CornerStreamHeader &header,
+                       nlohmann::json &scene_json);
+
+//! Board description from a .uson corner json. Missing keys are zero.
+CornerStreamHeader BoardHeaderFromJson(const nlohmann::json &scene_json);
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,114 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace io {
+
+// Compressed corner archive (.occz) for long term storage. The views are
+// grouped into blocks that are decoded one at a time. Within a block all
+// integers are LEB128 varints, signed values are zigzag encoded.
+//
+// header: "OICZ" | u32 version | u8 lossless | u32 views per block |
+//         board description as in the corner stream header
+// block:  "BLCK" | u32 nr views | u32 payload bytes | payload
+// view:   timestamp [ns] delta to the previous view | nr corners |
+//         u8 id coding | ids | corners | f32 sharpness |
+//         f32 saturated fraction
+// ids are sorted and coded either as gaps (0: first id, gaps) or as a
+// bitmap (1: first id, span, span bits), whichever is smaller. Corners
+// follow the sorted ids. They are stored as 1/256 px fixed point deltas to
+// the previous corner of the view, or as raw f64 if lossless.
+
+const std::string kCornerArchiveExtension = ".occz";
+const uint32_t kCornerArchiveVersion = 1;
+
+//! Returns true if path has the corner archive extension
+bool IsCornerArchivePath(const std::string &path);
+
+class CornerArchiveWriter {
+public:
+  //! Creates the file and writes the header
+  bool Open(const std::string &path, const CornerStreamHeader &header,
+            const bool lossless = false, const uint32_t views_per_block = 256);
+
+  //! Adds a view, full blocks are written to disk
+  bool WriteView(const double timestamp_us, const std::vector<int> &ids,
+                 const aligned_vector<Eigen::Vector2d> &corners,
+                 const ViewQuality &quality = ViewQuality());
+
+  //! Writes the last block and closes the file
+  bool Close();
+
+  bool IsOpen() const { return file_.is_open(); }
+
+private:
+  bool FlushBlock();
+
+  std::ofstream file_;
+  bool lossless_ = false;
+  uint32_t views_per_block_ = 256;
+  std::vector<uint8_t> block_;
+  uint32_t block_views_ = 0;
+  int64_t last_timestamp_ns_ = 0;
+};
+
+class CornerArchiveReader {
+public:
+  //! Opens the file and reads the header
+  bool Open(const std::string &path);
+
+  //! Decodes the next view. Returns false at the end of the file or for a
+  //! damaged block.
+  bool ReadNextView(double &timestamp_us, std::vector<int> &ids,
+                    aligned_vector<Eigen::Vector2d> &corners,
+                    ViewQuality &quality);
+
+  const CornerStreamHeader &Header() const { return header_; }
+
+  bool Lossless() const { return lossless_; }
+
+private:
+  bool ReadBlock();
+
+  std::ifstream file_;
+  CornerStreamHeader header_;
+  bool lossless_ = false;
+  std::vector<uint8_t> block_;
+  size_t block_pos_ = 0;
+  uint32_t block_views_left_ = 0;
+  int64_t last_timestamp_ns_ = 0;
+};
+
+//! Reads a corner archive into the same json layout as the .uson files
+bool read_scene_corner_archive(const std::string &input_path,
+                               nlohmann::json &scene_json);
+
+//! Writes a corner json (layout of the .uson files) as corner archive
+bool write_scene_corner_archive(const nlohmann::json &scene_json,
+                                const std::string &output_path,
+                                const bool lossless = false);
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,109 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace io {
+
+//! All views of a corner file in flat arrays, sorted by timestamp. The
+//! corners of view v are the entries [ViewBegin(v), ViewEnd(v)) of the point
+//! id and corner arrays. Built once, the calibration stages iterate it
+//! instead of parsing the json keys of every view and corner.
+class CornerDataset {
+public:
+  //! Reads any corner file (.uson, corner stream or corner archive)
+  bool Load(const std::string &path);
+
+  //! Only reads the selected views (see read_scene)
+  bool Load(const std::string &path, const ViewSelection &selection);
+
+  //! Converts a corner json (layout of the .uson files)
+  bool FromJson(const nlohmann::json &scene_json);
+
+  //! Reads a corner stream without building a json
+  bool FromCornerStream(const std::string &path,
+                        const ViewSelection &selection = ViewSelection());
+
+  //! Decodes a corner archive without building a json
+  bool FromCornerArchive(const std::string &path,
+                         const ViewSelection &selection = ViewSelection());
+
+  //! Board description, image size and frame rate
+  const CornerStreamHeader &Header() const { return header_; }
+
+  size_t NumViews() const { return timestamps_ns_.size(); }
+  size_t NumCorners() const { return point_ids_.size(); }
+
+  int64_t TimestampNs(const size_t view) const {
+    return timestamps_ns_[view];
+  }
+  double TimestampS(const size_t view) const {
+    return timestamps_ns_[view] * NS_TO_S;
+  }
+
+  size_t ViewBegin(const size_t view) const { return offsets_[view]; }
+  size_t ViewEnd(const size_t view) const { return offsets_[view + 1]; }
+  size_t NumCorners(const size_t view) const {
+    return offsets_[view + 1] - offsets_[view];
+  }
+
+  int PointId(const size_t corner) const { return point_ids_[corner]; }
+  Eigen::Vector2d Corner(const size_t corner) const {
+    return Eigen::Vector2d(xy_[2 * corner], xy_[2 * corner + 1]);
+  }
+
+  //! Zero if the corner file has no quality information
+  ViewQuality Quality(const size_t view) const { return qualities_[view]; }
+
+  //! Sorted view timestamps in nanoseconds
+  const std::vector<int64_t> &TimestampsNs() const { return timestamps_ns_; }
+  //! Board point id of every corner
+  const std::vector<int> &PointIds() const { return point_ids_; }
+  //! Interleaved x, y of every corner in pixels
+  const std::vector<double> &CornersXY() const { return xy_; }
+
+private:
+  void Clear();
+
+  void AddView(const int64_t timestamp_ns, const std::vector<int> &ids,
+               const aligned_vector<Eigen::Vector2d> &corners,
+               const ViewQuality &quality);
+
+  //! Sorts the views by timestamp if they were not added in order
+  void SortViews();
+
+  //! Drops all views but every k-th
+  void KeepEveryKthView(const int k);
+
+  CornerStreamHeader header_;
+  std::vector<int64_t> timestamps_ns_;
+  std::vector<size_t> offsets_{0};
+  std::vector<ViewQuality> qualities_;
+  std::vector<int> point_ids_;
+  std::vector<double> xy_;
+};
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,185 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace io {
+
+// Streaming corner file (.oicc). A header with the board description is
+// followed by one fixed layout record per view, which is appended as soon as
+// the view is extracted. All values are stored little endian.
+//
+// header: "OICC" | u32 version | i32 board type | f64 square size [m] |
+//         f64 fps | i32 image width | i32 image height | u32 nr scene pts |
+//         nr scene pts x (i32 id | f64 x | f64 y | f64 z)
+// record: "VIEW" | f64 timestamp [us] | f32 sharpness |
+//         f32 saturated fraction | u32 nr corners |
+//         nr corners x (i32 id | f64 x | f64 y)
+// Version 1 records have no sharpness and saturated fraction.
+//
+// Closing the writer appends a view index, which old readers stop at:
+// index:   "VIDX" | u32 nr views |
+//          nr views x (f64 timestamp [us] | u64 record offset) |
+//          u64 offset of "VIDX" | "OIDX"
+// The entries are sorted by timestamp. Files without index (e.g. of an
+// interrupted extraction) are indexed by skipping from record to record.
+
+const std::string kCornerStreamExtension = ".oicc";
+const uint32_t kCornerStreamVersion = 2;
+
+//! Image quality of a view, measured before the detection
+struct ViewQuality {
+  //! variance of the Laplacian on a thumbnail, low for blurred frames
+  float sharpness = 0.f;
+  //! fraction of (nearly) saturated pixels
+  float saturated_fraction = 0.f;
+};
+
+struct CornerStreamHeader {
+  int board_type = 0;
+  double square_size_meter = 0.0;
+  double camera_fps = 0.0;
+  int image_width = 0;
+  int image_height = 0;
+  std::vector<int> scene_pt_ids;
+  vec3_vector scene_pts;
+};
+
+//! Byte offset of a view record
+struct CornerStreamIndexEntry {
+  double timestamp_us = 0.0;
+  uint64_t offset = 0;
+};
+
+//! Views to read from a corner file: every k-th view with a timestamp in
+//! [start_s, end_s]
+struct ViewSelection {
+  double start_s = -std::numeric_limits<double>::infinity();
+  double end_s = std::numeric_limits<double>::infinity();
+  int every_kth_view = 1;
+
+  bool SelectsAll() const {
+    return every_kth_view <= 1 &&
+           start_s == -std::numeric_limits<double>::infinity() &&
+           end_s == std::numeric_limits<double>::infinity();
+  }
+};
+
+//! Returns true if path has the corner stream extension
+bool IsCornerStreamPath(const std::string &path);
+
+class CornerStreamWriter {
+public:
+  //! Creates the file and writes the header
+  bool Open(const std::string &path, const CornerStreamHeader &header);
+
+  //! Continues a partially written file. Everything after valid_bytes (e.g.
+  //! views written after the last checkpoint) is discarded. Fails for files
+  //! of another version and for files shorter than valid_bytes.
+  bool Resume(const std::string &path, const uint64_t valid_bytes);
+
+  //! Appends a view and flushes it to disk
+  bool WriteView(const double timestamp_us, const std::vector<int> &ids,
+                 const aligned_vector<Eigen::Vector2d> &corners,
+                 const ViewQuality &quality = ViewQuality());
+
+  //! Flushes the written views and waits until they are on disk. Call this
+  //! before recording BytesWritten() in a checkpoint.
+  bool Sync();
+
+  //! Appends the view index and closes the file. Returns false if any write
+  //! failed.
+  bool Close();
+
+  bool IsOpen() const { return file_.is_open(); }
+
+  //! Number of bytes in the file, without the view index
+  uint64_t BytesWritten() const { return bytes_written_; }
+
+private:
+  std::ofstream file_;
+  std::string path_;
+  uint64_t bytes_written_ = 0;
+  std::vector<CornerStreamIndexEntry> index_;
+};
+
+class CornerStreamReader {
+public:
+  //! Opens the file and reads the header
+  bool Open(const std::string &path);
+
+  //! Reads the next view. Returns false at the end of the file. A record that
+  //! was only partially written (e.g. after a crash) is ignored.
+  bool ReadNextView(double &timestamp_us, std::vector<int> &ids,
+                    aligned_vector<Eigen::Vector2d> &corners);
+
+  //! Also returns the view quality (zero for version 1 files)
+  bool ReadNextView(double &timestamp_us, std::vector<int> &ids,
+                    aligned_vector<Eigen::Vector2d> &corners,
+                    ViewQuality &quality);
+
+  //! View index sorted by timestamp. Read from the index at the end of the
+  //! file, or built by skipping over the records if there is none.
+  const std::vector<CornerStreamIndexEntry> &Index();
+
+  //! Positions of the selected views in Index()
+  std::vector<size_t> SelectViews(const ViewSelection &selection);
+
+  //! Reads the view at a position of Index()
+  bool ReadView(const size_t index_pos, double &timestamp_us,
+                std::vector<int> &ids, aligned_vector<Eigen::Vector2d> &corners,
+                ViewQuality &quality);
+
+  const CornerStreamHeader &Header() const { return header_; }
+
+  uint32_t Version() const { return version_; }
+
+private:
+  bool ReadIndexFooter();
+  void ScanIndex();
+
+  std::ifstream file_;
+  CornerStreamHeader header_;
+  uint32_t version_ = 0;
+  //! offset of the first view record
+  uint64_t data_start_ = 0;
+  bool index_loaded_ = false;
+  std::vector<CornerStreamIndexEntry> index_;
+};
+
+//! Reads a corner stream into the same json layout as the .uson files
+bool read_scene_corner_stream(const std::string &input_path,
+                              nlohmann::json &scene_json);
+
+//! Only reads the selected views, seeking to them with the view index
+bool read_scene_corner_stream(const std::string &input_path,
+                              const ViewSelection &selection,
+                              nlohmann::json &scene_json);
+
+//! Writes a corner json (layout of the .uson files) as corner stream
+bool write_scene_corner_stream(const nlohmann::json &scene_json,
+                               const std::string &output_path);
+
+} // namespace io
+} // namespace OpenICC
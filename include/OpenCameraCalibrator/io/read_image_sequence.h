@@ -0,0 +1,41 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OpenICC {
+namespace io {
+
+//! Reads a timestamp file of an image sequence. Every line contains an image
+//! file name and its timestamp in seconds, separated by a comma or
+//! whitespace. Lines starting with # are ignored.
+bool ReadImageTimestamps(const std::string &path_to_timestamps,
+                         std::map<std::string, double> &timestamps_s);
+
+//! Timestamps in seconds for the images of a sequence. They are taken from
+//! the timestamp file if one is given. Otherwise numeric file names
+//! (e.g. 1403636579763555584.png) are multiplied by file_name_to_s and as
+//! last resort the image index is divided by fps. image_paths is sorted by
+//! the timestamps. Fails if two images have the same timestamp.
+bool GetImageSequenceTimestamps(std::vector<std::string> &image_paths,
+                                const std::string &path_to_timestamps,
+                                const double file_name_to_s, const double fps,
+                                std::vector<double> &timestamps_s);
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,52 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace OpenICC {
+namespace io {
+
+//! Frame index of the first video track of an MP4/MOV file
+struct MP4FrameIndex {
+  //! Number of presented frames
+  int nr_frames = 0;
+  //! Keyframes (sync samples) as 0-based frame indices in presentation
+  //! order, which is the order of CAP_PROP_POS_FRAMES
+  std::vector<int> keyframes;
+  //! Samples have composition time offsets (B-frames), so the decode order
+  //! of the sample tables differs from the presentation order
+  bool reordered = false;
+};
+
+//! Reads the frame index of the first video track from its sample tables.
+//! Sample numbers are mapped from decode to presentation order with the
+//! decoding (stts) and composition (ctts) times, samples outside a single
+//! entry edit list (elst) are dropped. Returns false for files without
+//! sample tables or with edit lists that can not be mapped to frame
+//! numbers, these have to be decoded sequentially.
+bool ReadMP4KeyframeIndex(const std::string &path_to_video,
+                          MP4FrameIndex &index);
+
+//! Splits a video into [start, end) frame ranges that begin at a keyframe and
+//! contain at least min_chunk_frames frames (except for the last one).
+std::vector<std::pair<int, int>>
+KeyframeAlignedChunks(const int nr_frames, const std::vector<int> &keyframes,
+                      const int min_chunk_frames);
+
+} // namespace io
+} // namespace OpenICC
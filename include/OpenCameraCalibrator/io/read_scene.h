@@ -19,6 +19,7 @@
 
 #include "theia/sfm/reconstruction.h"
 
+#include <OpenCameraCalibrator/io/corner_stream.h>
 #include <OpenCameraCalibrator/utils/json.h>
 
 namespace OpenICC {
@@ -27,8 +28,25 @@ namespace io {
 bool read_scene_bson(const std::string &input_bson,
                      nlohmann::json &scene_json);
 
+//! Reads any corner file (.uson, corner stream or corner archive) into the
+//! .uson json layout
+bool read_scene(const std::string &input_path, nlohmann::json &scene_json);
+
+//! Only reads the views of a time window and / or every k-th view. Corner
+//! streams are accessed through their view index, such that the cost is
+//! proportional to the selected views. .uson files and corner archives have
+//! no index and are read completely before the views are filtered.
+bool read_scene(const std::string &input_path, const ViewSelection &selection,
+                nlohmann::json &scene_json);
+
 
 void scene_points_to_calib_dataset(const nlohmann::json &json, theia::Reconstruction &reconstruction);
 
+class CornerDataset;
+
+//! Adds the board points of a corner dataset as tracks
+void scene_points_to_calib_dataset(const CornerDataset &dataset,
+                                   theia::Reconstruction &reconstruction);
+
 } // namespace io
 } // namespace OpenICC
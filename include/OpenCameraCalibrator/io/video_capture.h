@@ -0,0 +1,45 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <opencv2/videoio.hpp>
+#include <string>
+
+namespace OpenICC {
+namespace io {
+
+//! Decoder output requested from OpenVideoCapture
+struct VideoDecodeOptions {
+  //! only decode the luminance plane
+  bool gray = false;
+  //! scale frames by 1/downsample_factor while decoding
+  double downsample_factor = 1.0;
+  //! only set in decoded: frames come from a GStreamer pipeline, whose frame
+  //! count and frame seeking are not reliable
+  bool gstreamer = false;
+};
+
+//! Opens a video for reading. The options are applied by the decoder
+//! (GStreamer pipeline with GRAY8 output and videoscale), which skips the YUV
+//! to BGR conversion and the full resolution frame copies. If that is not
+//! possible the video is opened with the default backend and delivers full
+//! resolution BGR frames and a warning is printed. decoded contains the
+//! options that are actually applied by the capture.
+bool OpenVideoCapture(const std::string &path_to_video,
+                      const VideoDecodeOptions &options,
+                      cv::VideoCapture &capture, VideoDecodeOptions &decoded);
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,79 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "OpenCameraCalibrator/utils/bounded_queue.h"
+
+namespace OpenICC {
+namespace utils {
+
+//! Displays or records frames on a separate consumer thread. When displaying,
+//! Show never blocks the caller: if the consumer falls behind, the oldest
+//! queued frames are dropped. If an output video is given, nothing is
+//! displayed and the annotated frames are encoded to that file instead
+//! (headless mode). Then Show waits for space in the queue, so the video
+//! contains every frame.
+class AsyncVisualizer {
+public:
+  //! Draws into the frame on the consumer thread
+  using Annotator = std::function<void(cv::Mat &)>;
+
+  AsyncVisualizer(const std::string &window_name,
+                  const std::string &output_video = "", const double fps = 30.0,
+                  const size_t queue_size = 4);
+  ~AsyncVisualizer();
+
+  AsyncVisualizer(const AsyncVisualizer &) = delete;
+  AsyncVisualizer &operator=(const AsyncVisualizer &) = delete;
+
+  //! Queues a frame. Gray frames are converted to BGR before the annotator
+  //! runs. The frame must not be modified by the caller afterwards.
+  void Show(const cv::Mat &image, Annotator annotate = nullptr);
+
+  //! Shows or writes the remaining frames and stops the consumer thread
+  void Close();
+
+  size_t NumShown() const { return num_shown_; }
+  size_t NumDropped() const { return num_dropped_; }
+
+private:
+  struct Frame {
+    cv::Mat image;
+    Annotator annotate;
+  };
+
+  void Consume();
+
+  std::string window_name_;
+  std::string output_video_;
+  double fps_;
+  cv::VideoWriter writer_;
+  cv::Size writer_size_;
+  BoundedQueue<Frame> queue_;
+  std::thread consumer_;
+  std::atomic<size_t> num_shown_{0};
+  std::atomic<size_t> num_dropped_{0};
+};
+
+} // namespace utils
+} // namespace OpenICC
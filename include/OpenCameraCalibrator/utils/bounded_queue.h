@@ -0,0 +1,105 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace OpenICC {
+
+// Simple blocking multi-producer / multi-consumer queue with a fixed capacity.
+// Producers block while the queue is full, consumers block while it is empty.
+// After Close() was called, Push fails and Pop drains the remaining items.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity) {
+    if (capacity_ == 0) {
+      capacity_ = 1;
+    }
+  }
+
+  // Blocks until there is space in the queue. Returns false if closed.
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock,
+                   [this] { return closed_ || queue_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    queue_.push_back(std::move(item));
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Never blocks. If the queue is full, the oldest item is dropped to make
+  // space and dropped is set. Returns false if closed.
+  bool PushDropOldest(T item, bool &dropped) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    dropped = false;
+    if (closed_) {
+      return false;
+    }
+    if (queue_.size() >= capacity_) {
+      queue_.pop_front();
+      dropped = true;
+    }
+    queue_.push_back(std::move(item));
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Blocks until an item is available. Returns false if the queue is closed
+  // and all items have been consumed.
+  bool Pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return false;
+    }
+    item = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Wakes up all waiting producers and consumers.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t Size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+private:
+  size_t capacity_;
+  bool closed_ = false;
+  std::deque<T> queue_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+} // namespace OpenICC
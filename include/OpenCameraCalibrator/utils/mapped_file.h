@@ -0,0 +1,52 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace OpenICC {
+namespace utils {
+
+//! Read-only memory mapping of a whole file. The contents are paged in by the
+//! kernel on access, nothing is copied to the heap.
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  //! Maps the file. sequential tells the kernel to read ahead aggressively
+  //! and to drop pages behind the reader.
+  bool Open(const std::string &path, const bool sequential = true);
+
+  void Close();
+
+  bool IsOpen() const { return is_open_; }
+
+  const std::uint8_t *Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+private:
+  const std::uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  bool is_open_ = false;
+};
+
+} // namespace utils
+} // namespace OpenICC
@@ -0,0 +1,72 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <theia/sfm/reconstruction.h>
+
+namespace OpenICC {
+namespace utils {
+
+//! Rounds a timestamp in seconds to integer nanoseconds
+int64_t TimestampSToNs(const double timestamp_s);
+
+//! The name every stage gives the view of a timestamp. Only used to keep
+//! the names unique. The continuous-time calibration looks views up through
+//! TimestampViewIndex, the other stages do not look views up by timestamp.
+std::string ViewNameFromTimestampNs(const int64_t timestamp_ns);
+
+//! Maps integer nanosecond timestamps to theia view ids. The entries are
+//! kept sorted, lookups are binary searches. Views are usually added in
+//! time order, which makes adding O(1).
+class TimestampViewIndex {
+public:
+  TimestampViewIndex() {}
+
+  //! Indexes all views of a reconstruction by their timestamp, which has to
+  //! be in seconds (not for spline reconstructions, which store ns)
+  explicit TimestampViewIndex(const theia::Reconstruction &reconstruction);
+
+  //! Returns false if the timestamp is already indexed
+  bool Add(const int64_t timestamp_ns, const theia::ViewId view_id);
+
+  //! Returns false if the timestamp is not indexed
+  bool Remove(const int64_t timestamp_ns);
+
+  //! Returns kInvalidViewId if there is no view at exactly this timestamp
+  theia::ViewId Find(const int64_t timestamp_ns) const;
+
+  //! Returns the view closest in time, or kInvalidViewId if it is further
+  //! away than max_distance_ns
+  theia::ViewId FindNearest(const int64_t timestamp_ns,
+                            const int64_t max_distance_ns) const;
+
+  size_t Size() const { return entries_.size(); }
+
+  bool Empty() const { return entries_.empty(); }
+
+  void Clear() { entries_.clear(); }
+
+private:
+  // (timestamp ns, view id), sorted by timestamp
+  std::vector<std::pair<int64_t, theia::ViewId>> entries_;
+};
+
+} // namespace utils
+} // namespace OpenICC
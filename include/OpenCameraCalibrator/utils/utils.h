@@ -27,6 +27,16 @@
 
 #include "OpenCameraCalibrator/utils/types.h"
 
+//! The ArUco3 detection is part of cv::aruco since OpenCV 4.5.3
+#if CV_VERSION_MAJOR > 4 ||                                                    \
+    (CV_VERSION_MAJOR == 4 &&                                                  \
+     (CV_VERSION_MINOR > 5 ||                                                  \
+      (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 3)))
+#define OPENICC_HAS_ARUCO3 1
+#else
+#define OPENICC_HAS_ARUCO3 0
+#endif
+
 namespace OpenICC {
 namespace utils {
 
@@ -35,6 +45,13 @@ bool DoesFileExist(const std::string &path);
 bool ReadDetectorParameters(std::string filename,
                             cv::Ptr<cv::aruco::DetectorParameters> &params);
 
+//! Also returns the cameraMotionSpeed of the ArUco3 detection, i.e. the
+//! expected relative marker size change between two frames. It is not part of
+//! cv::aruco::DetectorParameters.
+bool ReadDetectorParameters(std::string filename,
+                            cv::Ptr<cv::aruco::DetectorParameters> &params,
+                            double &camera_motion_speed);
+
 double MedianOfDoubleVec(std::vector<double> &double_vec);
 
 void PrintResult(const std::string cam_type,
@@ -45,6 +62,9 @@ std::string CameraIDToString(const int theia_enum);
 double GetReprojErrorOfView(const theia::Reconstruction &recon_dataset,
                             const theia::ViewId v_id);
 
+//! Paths of all images (by file extension) in a directory, in natural order
+//! (numbers in the file names are compared by value). Empty if the directory
+//! can not be opened.
 std::vector<std::string> load_images(const std::string &img_dir_path);
 
 int FindClosestTimestamp(const double t_imu,
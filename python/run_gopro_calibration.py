@@ -51,6 +51,7 @@ def main():
     parser.add_argument("--reestimate_bias_spline_opt", help="If biases should be also estimated during spline optimization", default=0, type=int)
     parser.add_argument("--optimize_board_points", help="if board points should be optimized during camera calibration and after pose estimation.", default=1, type=int)
     parser.add_argument("--verbose", help="If calibration steps should output more information.", default=1, type=int)
+    parser.add_argument("--cam_max_extraction_rate_hz", help="Maximum frame rate at which corners are extracted from the camera calibration video (e.g. 10). 0 extracts all frames. The imu to camera calibration video always uses all frames.", default=0, type=float)
 
     args = parser.parse_args()
 
@@ -98,8 +99,8 @@ def main():
     imu_bias_json =  pjoin(imu_bias_path, "imu_bias_"+bias_video_fn+".json")
     spline_weighting_json = pjoin(cam_imu_path, "spline_info_"+cam_imu_video_fn+".json")
     cam_imu_result_json = pjoin(cam_imu_path, "cam_imu_calib_result_"+cam_imu_video_fn+".json")
-    cam_imu_corners_json = pjoin(cam_imu_path, "cam_imu_corners_"+cam_imu_video_fn+".uson")
-    cam_corners_json = pjoin(cam_calib_path, "cam_corners_"+cam_video_fn+".uson")
+    cam_imu_corners_json = pjoin(cam_imu_path, "cam_imu_corners_"+cam_imu_video_fn+".oicc")
+    cam_corners_json = pjoin(cam_calib_path, "cam_corners_"+cam_video_fn+".oicc")
 
     gopro_telemetry = glob.glob(pjoin(cam_imu_path,"G*.MP4"))[0][:-4]+".json"
     imu_bias_telemetry_json_in = glob.glob(pjoin(imu_bias_path,"G*.MP4"))[0][:-4]+".json"
@@ -113,12 +114,14 @@ def main():
     print("Running corner extraction.")
     print("==================================================================")   
     start = time.time()
-    print("Extracing corners for camera calibration.")
-    cam_calib = Popen([pjoin(bin_path,'extract_board_to_json'),
-                    "--input_video=" + cam_calib_video[0],
+    print("Extracing corners for camera and imu camera calibration.")
+    corner_extraction = Popen([pjoin(bin_path,'extract_board_to_json'),
+                    "--input_video=" + cam_calib_video[0] + "," + cam_imu_video[0],
                     "--aruco_detector_params=" + aruco_detector_params,
                     "--board_type=" + args.board_type,
-                    "--save_corners_json_path=" + cam_corners_json,
+                    "--save_corners_json_path=" + cam_corners_json + "," + cam_imu_corners_json,
+                    "--max_extraction_rate_hz=" + str(args.cam_max_extraction_rate_hz) + ",0",
+                    "--imu_camera_video=" + cam_imu_video[0],
                     "--downsample_factor=" + str(args.image_downsample_factor),
                     "--checker_square_length_m=" + checker_size_m,
                     "--verbose=" + str(args.verbose),
@@ -126,21 +129,7 @@ def main():
                     "--num_squares_x="+str(args.num_squares_x),
                     "--num_squares_y="+str(args.num_squares_y),
                     "--logtostderr=1"])
-    error_cam_calib = cam_calib.wait()
-    print("Extracing corners for imu camera calibration.")
-    cam_imu_calib_corners = Popen([pjoin(bin_path,'extract_board_to_json'),
-                    "--input_video=" + cam_imu_video[0],
-                    "--aruco_detector_params=" + aruco_detector_params,
-                    "--board_type=" + args.board_type,
-                    "--save_corners_json_path=" + cam_imu_corners_json,
-                    "--downsample_factor=" + str(args.image_downsample_factor),
-                    "--checker_square_length_m=" + checker_size_m,
-                    "--verbose=" + str(args.verbose),
-                    "--recompute_corners=" + str(args.recompute_corners),
-                    "--num_squares_x="+str(args.num_squares_x),
-                    "--num_squares_y="+str(args.num_squares_y),
-                    "--logtostderr=1"])
-    error_cam_calib = cam_imu_calib_corners.wait()
+    error_cam_calib = corner_extraction.wait()
     print("Finished corner extraction.")
     print("==================================================================")
     print("Corner extraction took {:.2f}s.".format(time.time()-start))
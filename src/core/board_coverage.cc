@@ -0,0 +1,151 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/core/board_coverage.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/calib3d.hpp>
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+//! Views with fewer corners do not give a stable homography
+const int kMinPoseCorners = 8;
+
+//! Boards tilted less than this are frontal, the tilted bands start here
+const double kFrontalTiltDeg = 15.0;
+//! Width of the tilted bands. The last band takes all larger tilts.
+const double kTiltBandDeg = 15.0;
+
+} // namespace
+
+BoardCoverage::BoardCoverage(const cv::Size &image_size,
+                             const std::map<int, cv::Point2f> &board_pts,
+                             const int grid_cols)
+    : image_size_(image_size), board_pts_(board_pts),
+      grid_cols_(std::max(1, grid_cols)) {
+  grid_rows_ = std::max(
+      1, cvRound(grid_cols_ * static_cast<double>(image_size_.height) /
+                 std::max(1, image_size_.width)));
+  cell_corners_.assign(grid_cols_ * grid_rows_, 0);
+  pose_bin_views_.assign(kNumPoseBins, 0);
+}
+
+int BoardCoverage::AddView(const aligned_vector<Eigen::Vector2d> &corners,
+                           const std::vector<int> &ids) {
+  if (corners.empty() || image_size_.area() == 0) {
+    return -1;
+  }
+  ++num_views_;
+  std::vector<cv::Point2f> image_pts, board_pts;
+  for (size_t i = 0; i < corners.size(); ++i) {
+    const int col = std::min(
+        grid_cols_ - 1,
+        std::max(0, static_cast<int>(corners[i][0] * grid_cols_ /
+                                     image_size_.width)));
+    const int row = std::min(
+        grid_rows_ - 1,
+        std::max(0, static_cast<int>(corners[i][1] * grid_rows_ /
+                                     image_size_.height)));
+    ++cell_corners_[row * grid_cols_ + col];
+    const auto board_pt = board_pts_.find(ids[i]);
+    if (board_pt != board_pts_.end()) {
+      board_pts.push_back(board_pt->second);
+      image_pts.push_back(cv::Point2f(corners[i][0], corners[i][1]));
+    }
+  }
+  if (static_cast<int>(image_pts.size()) < kMinPoseCorners) {
+    return -1;
+  }
+  const cv::Mat H = cv::findHomography(board_pts, image_pts);
+  if (H.empty()) {
+    return -1;
+  }
+  // rotation columns of the board plane: K^-1 * H with an assumed focal
+  // length of the image width and the principal point in the image center
+  const double f = image_size_.width;
+  const double cx = 0.5 * image_size_.width;
+  const double cy = 0.5 * image_size_.height;
+  Eigen::Vector3d r1, r2;
+  for (int c = 0; c < 2; ++c) {
+    Eigen::Vector3d col((H.at<double>(0, c) - cx * H.at<double>(2, c)) / f,
+                        (H.at<double>(1, c) - cy * H.at<double>(2, c)) / f,
+                        H.at<double>(2, c));
+    (c == 0 ? r1 : r2) = col.normalized();
+  }
+  const Eigen::Vector3d normal = r1.cross(r2).normalized();
+  const double tilt_deg =
+      std::acos(std::min(1.0, std::abs(normal[2]))) * 180.0 / M_PI;
+  int bin = 0;
+  if (tilt_deg >= kFrontalTiltDeg) {
+    const int band = std::min(
+        kTiltBands - 1,
+        static_cast<int>((tilt_deg - kFrontalTiltDeg) / kTiltBandDeg));
+    // the sign of the normal is arbitrary, the tilt direction is taken from
+    // the normal pointing towards the camera
+    const double sign = normal[2] > 0.0 ? -1.0 : 1.0;
+    const double direction =
+        std::atan2(sign * normal[1], sign * normal[0]) + M_PI;
+    const int dir = std::min(
+        kTiltDirections - 1,
+        static_cast<int>(direction / (2.0 * M_PI) * kTiltDirections));
+    bin = 1 + band * kTiltDirections + dir;
+  }
+  ++pose_bin_views_[bin];
+  return bin;
+}
+
+double BoardCoverage::CellFraction() const {
+  const int covered = std::count_if(cell_corners_.begin(), cell_corners_.end(),
+                                    [](const int n) { return n > 0; });
+  return static_cast<double>(covered) / cell_corners_.size();
+}
+
+int BoardCoverage::NumPoseBins(const int min_views) const {
+  return std::count_if(pose_bin_views_.begin(), pose_bin_views_.end(),
+                       [min_views](const int n) {
+                         return n > 0 && n >= min_views;
+                       });
+}
+
+bool BoardCoverage::TargetsMet(const CoverageTargets &targets) const {
+  return CellFraction() >= targets.min_cell_fraction &&
+         NumPoseBins(targets.min_views_per_pose_bin) >= targets.min_pose_bins;
+}
+
+nlohmann::json BoardCoverage::ToJson() const {
+  nlohmann::json coverage;
+  coverage["image_width"] = image_size_.width;
+  coverage["image_height"] = image_size_.height;
+  coverage["grid_cols"] = grid_cols_;
+  coverage["grid_rows"] = grid_rows_;
+  coverage["num_views"] = num_views_;
+  coverage["cell_fraction"] = CellFraction();
+  // row major corner counts
+  coverage["cell_corners"] = cell_corners_;
+  coverage["frontal_tilt_deg"] = kFrontalTiltDeg;
+  coverage["tilt_band_deg"] = kTiltBandDeg;
+  coverage["tilt_bands"] = kTiltBands;
+  coverage["tilt_directions"] = kTiltDirections;
+  // bin 0 is frontal, then band major tilted bins
+  coverage["pose_bin_views"] = pose_bin_views_;
+  return coverage;
+}
+
+} // namespace core
+} // namespace OpenICC
@@ -24,10 +24,28 @@
 #include <theia/sfm/camera/pinhole_camera_model.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <fstream>
 #include <ios>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
+#include "OpenCameraCalibrator/core/board_coverage.h"
+#include "OpenCameraCalibrator/core/subpixel_refinement.h"
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/io/read_image_sequence.h"
+#include "OpenCameraCalibrator/io/read_mp4_index.h"
+#include "OpenCameraCalibrator/io/video_capture.h"
+#include "OpenCameraCalibrator/utils/async_visualizer.h"
+#include "OpenCameraCalibrator/utils/bounded_queue.h"
 #include "OpenCameraCalibrator/utils/json.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
@@ -36,17 +54,368 @@ using namespace cv;
 namespace OpenICC {
 namespace core {
 
+namespace {
+
+//! Minimum number of frames a decoder processes before it seeks
+const int kMinDecodeChunkFrames = 120;
+//! Number of consecutive images a decoder reads from an image sequence
+const int kImageChunkFrames = 16;
+
+//! Width of the thumbnail the frame quality is measured on
+const double kQualityThumbnailWidth = 480.0;
+//! Gray values from which on a pixel counts as saturated
+const int kSaturatedGrayValue = 250;
+
+//! A detection is only used to predict the board region for frames that are
+//! at most this many frames later
+const int kMaxTrackingFrameGap = 32;
+
+//! Minimum number of corners to accept a detection inside the tracked region
+const int kMinTrackedCorners = 4;
+
+//! With tracking, runs of this many consecutive frames go to the same
+//! detection worker
+const int kTrackingRunFrames = 16;
+
+//! A decoded frame waiting for detection
+struct FramePacket {
+  int frame_idx = 0;
+  //! frame number in the video
+  int video_frame = 0;
+  double timestamp_s = 0.0;
+  cv::Mat image;
+  //! image was already downsampled by the decoder
+  bool downsampled = false;
+  //! time to read and decode the frame
+  float decode_ms = 0.f;
+};
+
+//! Detection result of one frame
+struct FrameResult {
+  int frame_idx = 0;
+  int video_frame = 0;
+  double timestamp_s = 0.0;
+  cv::Size image_size;
+  aligned_vector<Eigen::Vector2d> corners;
+  std::vector<int> ids;
+  io::ViewQuality quality;
+  //! detection was skipped because of the frame quality
+  bool rejected = false;
+  //! only kept for the verbose plot
+  cv::Mat image;
+  StageTimes stage_ms{};
+};
+
+//! Hands the decoded frames to the detection workers. Without tracking any
+//! worker takes the next frame. With tracking, runs of run_frames
+//! consecutive frames go to the same worker, as the tracking state of a
+//! worker is only useful for the frames that follow its last one.
+class FrameDispatcher {
+public:
+  FrameDispatcher(const int num_workers, const int run_frames)
+      : run_frames_(run_frames) {
+    const int nr_queues = run_frames_ > 1 ? num_workers : 1;
+    for (int q = 0; q < nr_queues; ++q) {
+      queues_.emplace_back(new BoundedQueue<FramePacket>(
+          run_frames_ > 1 ? 2 : 2 * num_workers));
+    }
+  }
+
+  bool Push(FramePacket packet) {
+    const size_t q = (packet.frame_idx / std::max(1, run_frames_)) %
+                     queues_.size();
+    return queues_[q]->Push(std::move(packet));
+  }
+
+  bool Pop(const int worker, FramePacket &packet) {
+    return queues_[worker % queues_.size()]->Pop(packet);
+  }
+
+  void Close() {
+    for (auto &queue : queues_) {
+      queue->Close();
+    }
+  }
+
+private:
+  int run_frames_;
+  std::vector<std::unique_ptr<BoundedQueue<FramePacket>>> queues_;
+};
+
+//! Sharpness and exposure of a frame, measured on a thumbnail
+io::ViewQuality ComputeViewQuality(const cv::Mat &image) {
+  cv::Mat thumbnail;
+  const double scale = std::min(1.0, kQualityThumbnailWidth / image.cols);
+  cv::resize(image, thumbnail, cv::Size(), scale, scale, cv::INTER_AREA);
+  if (thumbnail.channels() != 1) {
+    cv::cvtColor(thumbnail, thumbnail, cv::COLOR_BGR2GRAY);
+  }
+  cv::Mat laplacian;
+  cv::Laplacian(thumbnail, laplacian, CV_32F);
+  cv::Scalar mean, stddev;
+  cv::meanStdDev(laplacian, mean, stddev);
+
+  io::ViewQuality quality;
+  quality.sharpness = static_cast<float>(stddev[0] * stddev[0]);
+  quality.saturated_fraction =
+      static_cast<float>(cv::countNonZero(thumbnail >= kSaturatedGrayValue)) /
+      thumbnail.total();
+  return quality;
+}
+
+//! Decides per decoded frame if it should go to the detector. One filter is
+//! shared by all decoders of a video. The extraction rate is limited by
+//! keeping at most one frame per 1 / max_rate_hz time slot, which does not
+//! depend on the order in which the decoders deliver the frames. Frames
+//! that barely differ from the last kept frame of the same decoder run
+//! (motion_reference) are skipped as well.
+class FrameSkipFilter {
+public:
+  FrameSkipFilter(const double min_motion, const double max_rate_hz)
+      : min_motion_(min_motion), max_rate_hz_(max_rate_hz) {}
+
+  //! Thread safe. motion_reference belongs to the calling decoder and is
+  //! cleared by it whenever it seeks.
+  bool Skip(const cv::Mat &image, const double timestamp_s,
+            cv::Mat &motion_reference) {
+    const int64_t slot =
+        max_rate_hz_ > 0.0
+            ? static_cast<int64_t>(std::floor(timestamp_s * max_rate_hz_))
+            : 0;
+    if (max_rate_hz_ > 0.0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (used_slots_.count(slot)) {
+        return true;
+      }
+    }
+    if (min_motion_ > 0.0) {
+      // mean absolute difference on a small gray thumbnail
+      const double scale = kThumbnailWidth / static_cast<double>(image.cols);
+      cv::Mat thumbnail;
+      cv::resize(image, thumbnail, cv::Size(), scale, scale, cv::INTER_AREA);
+      if (thumbnail.channels() != 1) {
+        cv::cvtColor(thumbnail, thumbnail, cv::COLOR_BGR2GRAY);
+      }
+      if (!motion_reference.empty() &&
+          cv::norm(thumbnail, motion_reference, cv::NORM_L1) /
+                  thumbnail.total() <
+              min_motion_) {
+        return true;
+      }
+      motion_reference = thumbnail;
+    }
+    if (max_rate_hz_ > 0.0) {
+      // another decoder may have taken the slot in the meantime
+      std::lock_guard<std::mutex> lock(mutex_);
+      return !used_slots_.insert(slot).second;
+    }
+    return false;
+  }
+
+  bool Enabled() const { return min_motion_ > 0.0 || max_rate_hz_ > 0.0; }
+
+private:
+  static constexpr int kThumbnailWidth = 64;
+  double min_motion_;
+  double max_rate_hz_;
+  std::mutex mutex_;
+  std::set<int64_t> used_slots_;
+};
+
+//! Progress of a corner stream extraction. Everything up to video_frame is
+//! contained in the first stream_bytes bytes of the corner stream.
+struct ExtractionCheckpoint {
+  int video_frame = -1;
+  double timestamp_s = 0.0;
+  uint64_t stream_bytes = 0;
+};
+
+bool WriteCheckpoint(const std::string &checkpoint_path,
+                     const std::string &video_path,
+                     const ExtractionCheckpoint &checkpoint) {
+  nlohmann::json checkpoint_json;
+  checkpoint_json["video_path"] = video_path;
+  checkpoint_json["video_frame"] = checkpoint.video_frame;
+  checkpoint_json["timestamp_s"] = checkpoint.timestamp_s;
+  checkpoint_json["stream_bytes"] = checkpoint.stream_bytes;
+  // write to a temporary file first, a crash must not corrupt the checkpoint
+  const std::string tmp_path = checkpoint_path + ".tmp";
+  {
+    std::ofstream file(tmp_path);
+    if (!file.is_open()) {
+      return false;
+    }
+    file << checkpoint_json;
+  }
+  return std::rename(tmp_path.c_str(), checkpoint_path.c_str()) == 0;
+}
+
+bool ReadCheckpoint(const std::string &checkpoint_path,
+                    ExtractionCheckpoint &checkpoint) {
+  std::ifstream file(checkpoint_path);
+  if (!file.is_open()) {
+    return false;
+  }
+  nlohmann::json checkpoint_json;
+  file >> checkpoint_json;
+  checkpoint.video_frame = checkpoint_json["video_frame"];
+  checkpoint.timestamp_s = checkpoint_json["timestamp_s"];
+  checkpoint.stream_bytes = checkpoint_json["stream_bytes"];
+  return true;
+}
+
+//! Interpolates the charuco corners with the local homographies of the
+//! adjacent markers like cv::aruco::interpolateCornersCharuco, but refines
+//! all corners of the frame at once with RefineCornersSubPix
+void InterpolateCharucoCorners(
+    const std::vector<std::vector<Point2f>> &marker_corners,
+    const std::vector<int> &marker_ids, const cv::Mat &image,
+    const cv::Ptr<aruco::CharucoBoard> &board,
+    const cv::Ptr<aruco::DetectorParameters> &params,
+    std::vector<Point2f> &charuco_corners, std::vector<int> &charuco_ids) {
+  charuco_corners.clear();
+  charuco_ids.clear();
+  cv::Mat gray = image;
+  if (image.channels() != 1) {
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+  }
+
+  // homography from board to image coordinates of every detected marker
+  std::map<int, int> board_marker_of_id;
+  for (size_t m = 0; m < board->ids.size(); ++m) {
+    board_marker_of_id[board->ids[m]] = m;
+  }
+  std::map<int, int> detection_of_marker_id;
+  std::vector<cv::Mat> homographies(marker_ids.size());
+  for (size_t m = 0; m < marker_ids.size(); ++m) {
+    const auto board_marker = board_marker_of_id.find(marker_ids[m]);
+    if (board_marker == board_marker_of_id.end()) {
+      continue;
+    }
+    std::vector<cv::Point2f> marker_obj_pts;
+    for (const auto &pt : board->objPoints[board_marker->second]) {
+      marker_obj_pts.push_back(cv::Point2f(pt.x, pt.y));
+    }
+    homographies[m] =
+        cv::getPerspectiveTransform(marker_obj_pts, marker_corners[m]);
+    detection_of_marker_id[marker_ids[m]] = m;
+  }
+
+  // refinement window of every corner, limited by the closest marker corner
+  std::map<int, std::vector<int>> corners_of_half_win;
+  const cv::Rect image_rect(0, 0, gray.cols, gray.rows);
+  for (size_t c = 0; c < board->chessboardCorners.size(); ++c) {
+    const cv::Point2f board_corner(board->chessboardCorners[c].x,
+                                   board->chessboardCorners[c].y);
+    cv::Point2f sum(0.f, 0.f);
+    std::vector<const Point2f *> closest_marker_corners;
+    for (size_t n = 0; n < board->nearestMarkerIdx[c].size(); ++n) {
+      const int board_marker = board->nearestMarkerIdx[c][n];
+      const auto detection =
+          detection_of_marker_id.find(board->ids[board_marker]);
+      if (detection == detection_of_marker_id.end()) {
+        continue;
+      }
+      const std::vector<Point2f> &detected = marker_corners[detection->second];
+      std::vector<cv::Point2f> estimate;
+      cv::perspectiveTransform(std::vector<cv::Point2f>{board_corner},
+                               estimate, homographies[detection->second]);
+      sum += estimate[0];
+      closest_marker_corners.push_back(
+          &detected[board->nearestMarkerCorners[c][n]]);
+    }
+    // at least two adjacent markers, as interpolateCornersCharuco
+    if (closest_marker_corners.size() < 2) {
+      continue;
+    }
+    const cv::Point2f corner = sum / float(closest_marker_corners.size());
+    if (!image_rect.contains(corner)) {
+      continue;
+    }
+    double min_dist = std::numeric_limits<double>::max();
+    for (const auto *marker_corner : closest_marker_corners) {
+      min_dist = std::min(min_dist, cv::norm(*marker_corner - corner));
+    }
+    const int half_win = std::max(1, std::min(10, int(min_dist - 2)));
+    corners_of_half_win[half_win].push_back(charuco_ids.size());
+    charuco_ids.push_back(c);
+    charuco_corners.push_back(corner);
+  }
+
+  for (const auto &group : corners_of_half_win) {
+    std::vector<Point2f> corners;
+    for (const int idx : group.second) {
+      corners.push_back(charuco_corners[idx]);
+    }
+    RefineCornersSubPix(gray, corners, group.first,
+                        params->cornerRefinementMaxIterations,
+                        params->cornerRefinementMinAccuracy);
+    for (size_t i = 0; i < group.second.size(); ++i) {
+      charuco_corners[group.second[i]] = corners[i];
+    }
+  }
+}
+
+} // namespace
+
 BoardExtractor::BoardExtractor() {}
 
+void BoardExtractor::SetNumThreads(const int num_threads) {
+  if (num_threads > 0) {
+    num_threads_ = num_threads;
+  } else {
+    num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+void BoardExtractor::SetNumDecoders(const int num_decoders) {
+  num_decoders_ = std::max(1, num_decoders);
+}
+
+void BoardExtractor::SetFrameSkipping(const double min_motion,
+                                      const double max_extraction_rate_hz) {
+  min_motion_ = min_motion;
+  max_extraction_rate_hz_ = max_extraction_rate_hz;
+}
+
+void BoardExtractor::SetCoarseToFine(const bool coarse_to_fine) {
+  coarse_to_fine_ = coarse_to_fine;
+}
+
+void BoardExtractor::SetRoiTracking(const bool roi_tracking,
+                                    const double roi_margin) {
+  roi_tracking_ = roi_tracking;
+  roi_margin_ = roi_margin;
+}
+
+DetectorState BoardExtractor::CloneDetectorState() const {
+  DetectorState state;
+  if (board_type_ != BoardType::CHARUCO) {
+    return state;
+  }
+  // detectMarkers writes to the parameters, so every thread needs a copy
+  state.detector_params =
+      cv::makePtr<aruco::DetectorParameters>(*detector_params_);
+  state.dictionary = cv::makePtr<aruco::Dictionary>(*dictionary_);
+  state.charucoboard = aruco::CharucoBoard::create(
+      charucoboard_->getChessboardSize().width,
+      charucoboard_->getChessboardSize().height,
+      charucoboard_->getSquareLength(), charucoboard_->getMarkerLength(),
+      state.dictionary);
+  state.board = state.charucoboard.staticCast<aruco::Board>();
+  return state;
+}
+
 bool BoardExtractor::InitializeCharucoBoard(std::string path_to_detector_params,
                                             float marker_length,
                                             float square_length, int squaresX,
-                                            int squaresY, int dictionaryId) {
+                                            int squaresY, int dictionaryId,
+                                            bool reduced_dictionary) {
   // load images from folder
   detector_params_ = aruco::DetectorParameters::create();
 
-  if (!OpenICC::utils::ReadDetectorParameters(path_to_detector_params,
-                                                   detector_params_)) {
+  if (!OpenICC::utils::ReadDetectorParameters(
+          path_to_detector_params, detector_params_, camera_motion_speed_)) {
     LOG(ERROR) << "Invalid detector parameters file\n";
     return 0;
   }
@@ -58,6 +427,23 @@ bool BoardExtractor::InitializeCharucoBoard(std::string path_to_detector_params,
                                               marker_length, dictionary_);
   board_ = charucoboard_.staticCast<aruco::Board>();
 
+  if (reduced_dictionary) {
+    // Only keep the markers that are on the board. Board ids index the rows
+    // of the byte list, so they stay valid for the reduced dictionary.
+    const int max_id =
+        *std::max_element(charucoboard_->ids.begin(), charucoboard_->ids.end());
+    CHECK_LT(max_id, dictionary_->bytesList.rows)
+        << "Board has more markers than the dictionary.";
+    dictionary_ = cv::makePtr<aruco::Dictionary>(
+        dictionary_->bytesList.rowRange(0, max_id + 1).clone(),
+        dictionary_->markerSize, dictionary_->maxCorrectionBits);
+    charucoboard_ = aruco::CharucoBoard::create(
+        squaresX, squaresY, square_length, marker_length, dictionary_);
+    board_ = charucoboard_.staticCast<aruco::Board>();
+    LOG(INFO) << "Matching markers against " << max_id + 1
+              << " dictionary entries.";
+  }
+
   board_pts3d_.push_back(charucoboard_->chessboardCorners);
   board_type_ = BoardType::CHARUCO;
 
@@ -72,6 +458,7 @@ bool BoardExtractor::InitializeRadonBoard(float square_length, int squaresX,
   radon_pattern_size_ = cv::Size(squaresX, squaresY);
   radon_flags_ =
       cv::CALIB_CB_LARGER | cv::CALIB_CB_MARKER | cv::CALIB_CB_EXHAUSTIVE;
+  radon_tracker_.reset(new RadonBoardTracker(radon_pattern_size_));
   std::vector<cv::Point3f> board_pts;
   int cont_idx = 0;
   for (int i = 0; i < radon_pattern_size_.height; ++i) {
@@ -89,59 +476,391 @@ bool BoardExtractor::InitializeRadonBoard(float square_length, int squaresX,
   return true;
 }
 
+cv::Rect BoardExtractor::PredictBoardRoi(const cv::Rect2f &last_board_bbox,
+                                         const int frame_gap,
+                                         const cv::Size &image_size) const {
+  // the further away the last detection, the more the board could have moved
+  const float margin = roi_margin_ *
+                       std::max(last_board_bbox.width, last_board_bbox.height) *
+                       std::sqrt(static_cast<float>(frame_gap));
+  cv::Rect roi(cvFloor(last_board_bbox.x - margin),
+               cvFloor(last_board_bbox.y - margin),
+               cvCeil(last_board_bbox.width + 2.f * margin),
+               cvCeil(last_board_bbox.height + 2.f * margin));
+  return roi & cv::Rect(0, 0, image_size.width, image_size.height);
+}
+
+bool BoardExtractor::DetectCharucoCorners(
+    const cv::Mat &detect_image, const cv::Mat &image,
+    const double detect_scale, const cv::Rect &roi, DetectorState &state,
+    std::vector<cv::Point2f> &charuco_corners, std::vector<int> &charuco_ids,
+    cv::Rect2f &board_bbox) {
+  std::vector<int> marker_ids;
+  std::vector<std::vector<Point2f>> marker_corners, rejected_markers;
+
+#if OPENICC_HAS_ARUCO3
+  // ArUco3: markers shrink by at most the camera motion speed per frame, so
+  // scales below the smallest marker of the last frame are skipped
+  if (state.detector_params->useAruco3Detection) {
+    float min_length_ratio = detector_params_->minMarkerLengthRatioOriginalImg;
+    const int frame_gap = state.frame_idx - state.last_marker_frame_idx;
+    if (state.last_min_marker_side > 0.f && frame_gap > 0 &&
+        frame_gap <= kMaxTrackingFrameGap) {
+      min_length_ratio = std::min(
+          1.f, static_cast<float>(
+                   std::pow(1.0 - camera_motion_speed_, frame_gap) *
+                   state.last_min_marker_side /
+                   std::max(roi.width, roi.height)));
+    }
+    state.detector_params->minMarkerLengthRatioOriginalImg = min_length_ratio;
+  }
+#endif
+  {
+    ScopedStageTimer timer(state.stage_ms, ExtractionStage::DETECT_MARKERS);
+    aruco::detectMarkers(detect_image(roi), state.dictionary, marker_corners,
+                         marker_ids, state.detector_params, rejected_markers);
+  }
+  state.last_marker_frame_idx = state.frame_idx;
+  state.last_min_marker_side = 0.f;
+  for (const auto &marker : marker_corners) {
+    const float side = static_cast<float>(cv::arcLength(marker, true) / 4.0);
+    if (state.last_min_marker_side == 0.f ||
+        side < state.last_min_marker_side) {
+      state.last_min_marker_side = side;
+    }
+  }
+  // back to full image coordinates (pixel centers at integer positions)
+  const float scale = static_cast<float>(detect_scale);
+  const cv::Point2f offset(roi.x + 0.5f, roi.y + 0.5f);
+  const cv::Point2f half_pixel(0.5f, 0.5f);
+  for (auto &marker : marker_corners) {
+    for (auto &pt : marker) {
+      pt = (pt + offset) * scale - half_pixel;
+    }
+  }
+  for (auto &marker : rejected_markers) {
+    for (auto &pt : marker) {
+      pt = (pt + offset) * scale - half_pixel;
+    }
+  }
+
+  // refind strategy to detect more markers
+  {
+    ScopedStageTimer timer(state.stage_ms, ExtractionStage::REFINE_MARKERS);
+    aruco::refineDetectedMarkers(image, state.board, marker_corners,
+                                 marker_ids, rejected_markers);
+  }
+
+  if (marker_ids.empty()) {
+    return false;
+  }
+
+  // interpolate charuco corners
+  {
+    ScopedStageTimer timer(state.stage_ms,
+                           ExtractionStage::INTERPOLATE_CORNERS);
+    if (batched_subpix_) {
+      InterpolateCharucoCorners(marker_corners, marker_ids, image,
+                                state.charucoboard, state.detector_params,
+                                charuco_corners, charuco_ids);
+    } else {
+      aruco::interpolateCornersCharuco(marker_corners, marker_ids, image,
+                                       state.charucoboard, charuco_corners,
+                                       charuco_ids);
+    }
+  }
+
+  // the markers enclose the whole board, the charuco corners do not
+  std::vector<Point2f> all_marker_corners;
+  for (const auto &marker : marker_corners) {
+    all_marker_corners.insert(all_marker_corners.end(), marker.begin(),
+                              marker.end());
+  }
+  board_bbox = cv::boundingRect(all_marker_corners);
+  return true;
+}
+
+void BoardExtractor::CountMarkersPerThresholdWindow(
+    const cv::Mat &image, DetectorState &state) const {
+  const int win_min = detector_params_->adaptiveThreshWinSizeMin;
+  const int win_step = std::max(1, detector_params_->adaptiveThreshWinSizeStep);
+  const int nr_windows =
+      (detector_params_->adaptiveThreshWinSizeMax - win_min) / win_step + 1;
+  ThresholdWindowLock &lock = state.threshold_lock;
+  lock.markers_per_window.resize(nr_windows, 0);
+  // one detection per window size, the sweep itself does not tell which
+  // window found a marker
+  cv::Ptr<aruco::DetectorParameters> params =
+      cv::makePtr<aruco::DetectorParameters>(*state.detector_params);
+  for (int w = 0; w < nr_windows; ++w) {
+    params->adaptiveThreshWinSizeMin = win_min + w * win_step;
+    params->adaptiveThreshWinSizeMax = params->adaptiveThreshWinSizeMin;
+    std::vector<int> marker_ids;
+    std::vector<std::vector<Point2f>> marker_corners;
+    aruco::detectMarkers(image, state.dictionary, marker_corners, marker_ids,
+                         params);
+    lock.markers_per_window[w] += marker_ids.size();
+  }
+}
+
+void BoardExtractor::UpdateThresholdWindowLock(const bool found_markers,
+                                               DetectorState &state) const {
+  ThresholdWindowLock &lock = state.threshold_lock;
+  if (!lock.locked) {
+    ++lock.warmup_frames;
+    lock.warmup_detections += found_markers;
+    if (lock.warmup_detections < threshold_warmup_frames_) {
+      return;
+    }
+    // keep the window sizes that found a relevant part of the markers
+    const int max_markers = *std::max_element(lock.markers_per_window.begin(),
+                                              lock.markers_per_window.end());
+    if (max_markers == 0) {
+      lock = ThresholdWindowLock();
+      return;
+    }
+    int first = -1, last = -1;
+    for (int w = 0; w < static_cast<int>(lock.markers_per_window.size());
+         ++w) {
+      if (lock.markers_per_window[w] >= 0.1 * max_markers) {
+        first = first < 0 ? w : first;
+        last = w;
+      }
+    }
+    const int win_min = detector_params_->adaptiveThreshWinSizeMin;
+    const int win_step =
+        std::max(1, detector_params_->adaptiveThreshWinSizeStep);
+    state.detector_params->adaptiveThreshWinSizeMin = win_min + first * win_step;
+    state.detector_params->adaptiveThreshWinSizeMax = win_min + last * win_step;
+    lock.locked = true;
+    lock.warmup_detection_rate =
+        static_cast<double>(lock.warmup_detections) / lock.warmup_frames;
+    lock.detection_rate = lock.warmup_detection_rate;
+    VLOG(1) << "Locked threshold window sizes to ["
+            << state.detector_params->adaptiveThreshWinSizeMin << ", "
+            << state.detector_params->adaptiveThreshWinSizeMax << "].";
+    return;
+  }
+
+  // restore the full sweep if the narrowed one misses boards
+  const double alpha = 2.0 / (threshold_warmup_frames_ + 1);
+  lock.detection_rate =
+      (1.0 - alpha) * lock.detection_rate + alpha * (found_markers ? 1.0 : 0.0);
+  if (lock.detection_rate < 0.5 * lock.warmup_detection_rate) {
+    state.detector_params->adaptiveThreshWinSizeMin =
+        detector_params_->adaptiveThreshWinSizeMin;
+    state.detector_params->adaptiveThreshWinSizeMax =
+        detector_params_->adaptiveThreshWinSizeMax;
+    lock = ThresholdWindowLock();
+    VLOG(1) << "Detection rate dropped, unlocked threshold window sizes.";
+  }
+}
+
+void BoardExtractor::SetAruco3Detection(const bool use_aruco3) {
+#if OPENICC_HAS_ARUCO3
+  if (detector_params_) {
+    detector_params_->useAruco3Detection = use_aruco3;
+  }
+#else
+  LOG_IF(WARNING, use_aruco3) << "ArUco3 detection needs OpenCV >= 4.5.3.";
+#endif
+}
+
 bool BoardExtractor::ExtractBoard(const Mat &image,
                                   aligned_vector<Eigen::Vector2d> &corners,
                                   std::vector<int> &object_pt_ids) {
+  DetectorState state;
+  state.detector_params = detector_params_;
+  state.dictionary = dictionary_;
+  state.charucoboard = charucoboard_;
+  state.board = board_;
+  return ExtractBoard(image, state, corners, object_pt_ids);
+}
+
+bool BoardExtractor::ExtractBoard(const Mat &image, DetectorState &state,
+                                  aligned_vector<Eigen::Vector2d> &corners,
+                                  std::vector<int> &object_pt_ids) {
+  return ExtractBoard(image, image, 1.0, state, corners, object_pt_ids);
+}
+
+bool BoardExtractor::ExtractBoard(const cv::Mat &detect_image,
+                                  const cv::Mat &image,
+                                  const double detect_scale,
+                                  DetectorState &state,
+                                  aligned_vector<Eigen::Vector2d> &corners,
+                                  std::vector<int> &object_pt_ids) {
 
   if (board_type_ == BoardType::CHARUCO) {
-    std::vector<int> marker_ids, charuco_ids;
-    std::vector<std::vector<Point2f>> marker_corners, rejected_markers;
+    std::vector<int> charuco_ids;
     std::vector<Point2f> charuco_corners;
+    cv::Rect2f board_bbox;
+    bool found_markers = false;
+    // region of the detect image in which the markers were found
+    cv::Rect marker_roi;
 
-    aruco::detectMarkers(image, dictionary_, marker_corners, marker_ids,
-                         detector_params_, rejected_markers);
-
-    // refind strategy to detect more markers
-    aruco::refineDetectedMarkers(image, board_, marker_corners, marker_ids,
-                                 rejected_markers);
+    // try to find the board close to where it was in the previous frame
+    const int frame_gap = state.frame_idx - state.last_tracked_frame_idx;
+    if (roi_tracking_ && state.last_tracked_frame_idx >= 0 && frame_gap > 0 &&
+        frame_gap <= kMaxTrackingFrameGap) {
+      const auto t_roi = std::chrono::steady_clock::now();
+      const cv::Rect2f bbox_detect(
+          state.last_board_bbox.x / detect_scale,
+          state.last_board_bbox.y / detect_scale,
+          state.last_board_bbox.width / detect_scale,
+          state.last_board_bbox.height / detect_scale);
+      const cv::Rect roi =
+          PredictBoardRoi(bbox_detect, frame_gap, detect_image.size());
+      if (roi.area() > 0) {
+        found_markers = DetectCharucoCorners(detect_image, image, detect_scale,
+                                             roi, state, charuco_corners,
+                                             charuco_ids, board_bbox);
+        marker_roi = roi;
+      }
+      const int min_corners = std::max(
+          kMinTrackedCorners, state.last_num_tracked_corners / 2);
+      if (found_markers && (int)charuco_ids.size() < min_corners) {
+        found_markers = false;
+        charuco_corners.clear();
+        charuco_ids.clear();
+      }
+      state.tracking_stats.roi_attempts++;
+      state.tracking_stats.roi_time_ms +=
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - t_roi)
+              .count();
+      if (found_markers) {
+        state.tracking_stats.roi_hits++;
+      }
+    }
 
-    // interpolate charuco corners
-    int interpolatedCorners = 0;
-    if (marker_ids.size() > 0) {
-      interpolatedCorners = aruco::interpolateCornersCharuco(
-          marker_corners, marker_ids, image, charucoboard_, charuco_corners,
-          charuco_ids);
+    // full frame search
+    if (!found_markers) {
+      const auto t_full = std::chrono::steady_clock::now();
+      marker_roi = cv::Rect(0, 0, detect_image.cols, detect_image.rows);
+      found_markers =
+          DetectCharucoCorners(detect_image, image, detect_scale, marker_roi,
+                               state, charuco_corners, charuco_ids, board_bbox);
+      state.tracking_stats.full_frames++;
+      state.tracking_stats.full_time_ms +=
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - t_full)
+              .count();
+    }
 
-      object_pt_ids = charuco_ids;
-      for (int i = 0; i < charuco_corners.size(); ++i) {
-        corners.push_back(
-            Eigen::Vector2d(charuco_corners[i].x, charuco_corners[i].y));
+    // once per frame, the window sizes are only locked for thread local
+    // detector parameters
+    if (threshold_warmup_frames_ > 0 &&
+        state.detector_params != detector_params_) {
+      // frames without markers do not tell anything about the window sizes
+      if (!state.threshold_lock.locked && found_markers) {
+        ScopedStageTimer timer(state.stage_ms,
+                               ExtractionStage::THRESHOLD_WARMUP);
+        CountMarkersPerThresholdWindow(detect_image(marker_roi), state);
       }
-      return true;
+      UpdateThresholdWindowLock(found_markers, state);
+    }
+
+    if ((int)charuco_ids.size() >= kMinTrackedCorners) {
+      state.last_tracked_frame_idx = state.frame_idx;
+      state.last_board_bbox = board_bbox;
+      state.last_num_tracked_corners = charuco_ids.size();
     } else {
+      state.last_tracked_frame_idx = -1;
+    }
+
+    if (!found_markers) {
       return false;
     }
+    object_pt_ids = charuco_ids;
+    for (int i = 0; i < charuco_corners.size(); ++i) {
+      corners.push_back(
+          Eigen::Vector2d(charuco_corners[i].x, charuco_corners[i].y));
+    }
+    return true;
 
   } else if (board_type_ == BoardType::RADON) {
-    std::vector<Point2d> radon_corners;
+    std::vector<Point2f> radon_corners;
     cv::Mat meta;
-    bool success = cv::findChessboardCornersSB(
-        image, radon_pattern_size_, radon_corners, radon_flags_, meta);
-    if (!success)
+    bool success = false;
+
+    // track the corners of the previous frame, the exhaustive search is only
+    // needed to find the board again
+    const int frame_gap = state.frame_idx - state.last_tracked_frame_idx;
+    if (roi_tracking_ && state.last_tracked_frame_idx >= 0 && frame_gap > 0 &&
+        frame_gap <= kMaxTrackingFrameGap) {
+      ScopedStageTimer timer(state.stage_ms,
+                             ExtractionStage::CHESSBOARD_DETECTION);
+      const auto track_start = std::chrono::steady_clock::now();
+      success = radon_tracker_->Track(detect_image, state.last_radon_corners,
+                                      state.last_radon_meta, radon_corners);
+      state.tracking_stats.roi_time_ms +=
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - track_start)
+              .count();
+      state.tracking_stats.roi_attempts++;
+      if (success) {
+        state.tracking_stats.roi_hits++;
+        meta = state.last_radon_meta;
+      }
+    }
+    if (!success) {
+      ScopedStageTimer timer(state.stage_ms,
+                             ExtractionStage::CHESSBOARD_DETECTION);
+      const auto full_start = std::chrono::steady_clock::now();
+      success = cv::findChessboardCornersSB(detect_image, radon_pattern_size_,
+                                            radon_corners, radon_flags_, meta);
+      // CALIB_CB_LARGER may return a larger grid. Without knowing where the
+      // pattern lies in it the corners can not be given board ids.
+      if (success &&
+          radon_corners.size() !=
+              static_cast<size_t>(radon_pattern_size_.area())) {
+        VLOG(1) << "Ignoring a " << meta.cols << "x" << meta.rows
+                << " grid, the board has " << radon_pattern_size_.width
+                << "x" << radon_pattern_size_.height << " corners.";
+        success = false;
+      }
+      state.tracking_stats.full_time_ms +=
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - full_start)
+              .count();
+      state.tracking_stats.full_frames++;
+    }
+    if (!success) {
+      state.last_tracked_frame_idx = -1;
       return false;
-    int lf = 0;
-    for (int i = 0; i < radon_pattern_size_.height; ++i) {
-      for (int j = 0; j < radon_pattern_size_.width; ++j) {
-        if ((int)meta.at<uchar>(i, j) >= 0) {
-          object_pt_ids.push_back(radon_board_indices_[lf]);
-        }
-        lf++;
+    }
+    state.last_tracked_frame_idx = state.frame_idx;
+    state.last_radon_corners = radon_corners;
+    state.last_radon_meta = meta;
+    if (detect_scale != 1.0) {
+      ScopedStageTimer timer(state.stage_ms, ExtractionStage::REFINE_CORNERS);
+      // refine the upscaled coarse corners on the full resolution image
+      const float scale = static_cast<float>(detect_scale);
+      for (auto &pt : radon_corners) {
+        pt = (pt + cv::Point2f(0.5f, 0.5f)) * scale - cv::Point2f(0.5f, 0.5f);
+      }
+      cv::Mat gray = image;
+      if (image.channels() != 1) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+      }
+      const int win = cvCeil(detect_scale) + 1;
+      if (batched_subpix_) {
+        RefineCornersSubPix(gray, radon_corners, win);
+      } else {
+        cv::cornerSubPix(gray, radon_corners, cv::Size(win, win),
+                         cv::Size(-1, -1),
+                         cv::TermCriteria(cv::TermCriteria::EPS +
+                                              cv::TermCriteria::COUNT,
+                                          20, 0.01));
       }
     }
+    // the corners are in row major order of the pattern
     for (int i = 0; i < radon_corners.size(); ++i) {
+      object_pt_ids.push_back(radon_board_indices_[i]);
       corners.push_back(
           Eigen::Vector2d(radon_corners[i].x, radon_corners[i].y));
     }
+    CHECK_EQ(object_pt_ids.size(), corners.size());
   } else {
     LOG(WARNING) << " Board type does not exist.";
     return false;
@@ -153,6 +872,110 @@ bool BoardExtractor::ExtractBoard(const Mat &image,
 bool BoardExtractor::ExtractVideoToJson(const std::string &video_path,
                                         const std::string &save_path,
                                         const double img_downsample_factor) {
+  return ExtractVideoToJson(video_path, save_path, img_downsample_factor,
+                            num_threads_, max_extraction_rate_hz_, min_motion_,
+                            verbose_plot_);
+}
+
+bool BoardExtractor::ExtractVideosToJson(
+    const std::vector<std::string> &video_paths,
+    const std::vector<std::string> &save_paths,
+    const double img_downsample_factor,
+    const std::vector<double> &max_extraction_rates_hz,
+    const std::vector<double> &min_motions) {
+  if (video_paths.size() != save_paths.size()) {
+    LOG(ERROR) << "Got " << video_paths.size() << " videos but "
+               << save_paths.size() << " save paths.\n";
+    return false;
+  }
+  if (!max_extraction_rates_hz.empty() &&
+      max_extraction_rates_hz.size() != video_paths.size()) {
+    LOG(ERROR) << "Got " << video_paths.size() << " videos but "
+               << max_extraction_rates_hz.size() << " extraction rates.\n";
+    return false;
+  }
+  if (!min_motions.empty() && min_motions.size() != video_paths.size()) {
+    LOG(ERROR) << "Got " << video_paths.size() << " videos but "
+               << min_motions.size() << " motion thresholds.\n";
+    return false;
+  }
+  if (video_paths.empty()) {
+    return true;
+  }
+  std::vector<double> max_rates_hz = max_extraction_rates_hz;
+  if (max_rates_hz.empty()) {
+    max_rates_hz.resize(video_paths.size(), max_extraction_rate_hz_);
+  }
+  std::vector<double> motions = min_motions;
+  if (motions.empty()) {
+    motions.resize(video_paths.size(), min_motion_);
+  }
+  if (video_paths.size() == 1) {
+    return ExtractVideoToJson(video_paths[0], save_paths[0],
+                              img_downsample_factor, num_threads_,
+                              max_rates_hz[0], motions[0], verbose_plot_);
+  }
+
+  // split the threads proportional to the video lengths, such that all videos
+  // finish at about the same time. Videos run num_decoders_ decoder threads
+  // next to their detection threads, image directories one decoder per
+  // detection thread.
+  std::vector<double> nr_frames(video_paths.size(), 1.0);
+  std::vector<char> is_image_sequence(video_paths.size(), false);
+  double total_nr_frames = 0.0;
+  int decoder_threads = 0;
+  for (size_t i = 0; i < video_paths.size(); ++i) {
+    const size_t nr_images = utils::load_images(video_paths[i]).size();
+    VideoCapture video;
+    if (nr_images > 0) {
+      nr_frames[i] = nr_images;
+      is_image_sequence[i] = true;
+    } else {
+      if (video.open(video_paths[i])) {
+        nr_frames[i] = std::max(1.0, video.get(cv::CAP_PROP_FRAME_COUNT));
+      }
+      decoder_threads += num_decoders_;
+    }
+    total_nr_frames += nr_frames[i];
+  }
+  const int available_threads = std::max(
+      static_cast<int>(video_paths.size()), num_threads_ - decoder_threads);
+  if (verbose_plot_) {
+    LOG(WARNING) << "Corners are not displayed when extracting several "
+                    "videos at once.";
+  }
+
+  std::vector<std::thread> extractions;
+  std::vector<char> success(video_paths.size(), false);
+  for (size_t i = 0; i < video_paths.size(); ++i) {
+    const int video_threads = static_cast<int>(
+        std::round(available_threads * nr_frames[i] / total_nr_frames));
+    const int num_workers =
+        std::max(1, is_image_sequence[i] ? video_threads / 2 : video_threads);
+    LOG(INFO) << "Extracting " << video_paths[i] << " with " << num_workers
+              << " detection and "
+              << (is_image_sequence[i] ? num_workers : num_decoders_)
+              << " decoder threads (" << num_threads_ << " in total).";
+    extractions.emplace_back([&, i, num_workers]() {
+      success[i] = ExtractVideoToJson(video_paths[i], save_paths[i],
+                                      img_downsample_factor, num_workers,
+                                      max_rates_hz[i], motions[i], false);
+    });
+  }
+  for (auto &extraction : extractions) {
+    extraction.join();
+  }
+  return std::all_of(success.begin(), success.end(),
+                     [](const char s) { return s; });
+}
+
+bool BoardExtractor::ExtractVideoToJson(const std::string &video_path,
+                                        const std::string &save_path,
+                                        const double img_downsample_factor,
+                                        const int num_threads,
+                                        const double max_rate_hz,
+                                        const double min_motion,
+                                        const bool plot) {
   if (!board_initialized_) {
     LOG(ERROR) << "No board initialized.\n";
     return false;
@@ -163,10 +986,37 @@ bool BoardExtractor::ExtractVideoToJson(const std::string &video_path,
   }
 
   nlohmann::json output_json;
+  // the decoder can only downsample if the full resolution is not needed
+  io::VideoDecodeOptions decode_options;
+  decode_options.gray = gray_decoding_;
+  if (decoder_scaling_ && !coarse_to_fine_) {
+    decode_options.downsample_factor = img_downsample_factor;
+  }
+  // a directory is read as image sequence
+  // sorted by timestamp below
+  std::vector<std::string> image_paths = utils::load_images(video_path);
+  const bool image_sequence = !image_paths.empty();
+  std::vector<double> image_timestamps_s;
   VideoCapture input_video;
-  input_video.open(video_path);
-  int cnt_wrong = 0;
-  double fps = input_video.get(cv::CAP_PROP_FPS);
+  io::VideoDecodeOptions decoded;
+  double fps = image_fps_;
+  if (image_sequence) {
+    if (!io::GetImageSequenceTimestamps(image_paths, image_timestamps_path_,
+                                        image_file_name_to_s_, image_fps_,
+                                        image_timestamps_s)) {
+      LOG(ERROR) << "Could not get timestamps of the images in "
+                 << video_path << "\n";
+      return false;
+    }
+    decoded.gray = gray_decoding_;
+  } else {
+    io::OpenVideoCapture(video_path, decode_options, input_video, decoded);
+    if (!input_video.isOpened()) {
+      LOG(ERROR) << "Could not open video " << video_path << "\n";
+      return false;
+    }
+    fps = input_video.get(cv::CAP_PROP_FPS);
+  }
 
   output_json["camera_fps"] = fps;
   output_json["calibration_board_type"] = board_type_;
@@ -186,59 +1036,651 @@ bool BoardExtractor::ExtractVideoToJson(const std::string &video_path,
     }
   }
 
-  const int total_nr_frames = input_video.get(cv::CAP_PROP_FRAME_COUNT);
-  int frame_cnt = 0;
-  bool set_img_size = false;
-  while (true) {
-    Mat image;
-    if (!input_video.read(image)) {
-      cnt_wrong++;
-      if (cnt_wrong > 500)
-        break;
-      continue;
+  // corner streams are written view by view, the json is built in memory
+  const bool stream_output = io::IsCornerStreamPath(save_path);
+  io::CornerStreamWriter stream_writer;
+  io::CornerStreamHeader stream_header;
+  stream_header.board_type = board_type_;
+  stream_header.square_size_meter = square_length_m_;
+  stream_header.camera_fps = fps;
+  for (size_t i = 0; i < board_pts.size(); ++i) {
+    stream_header.scene_pt_ids.push_back(
+        board_type_ == BoardType::RADON ? GetRadonBoardIDs()[i] : (int)i);
+    stream_header.scene_pts.push_back(
+        Eigen::Vector3d(board_pts[i].x, board_pts[i].y, board_pts[i].z));
+  }
+
+  // continue an interrupted corner stream after its last checkpoint
+  const std::string checkpoint_path = CheckpointPath(save_path);
+  int start_video_frame = 0;
+  if (resume_) {
+    ExtractionCheckpoint checkpoint;
+    if (!stream_output) {
+      LOG(WARNING) << "Resuming is only supported for corner streams ("
+                   << io::kCornerStreamExtension
+                   << "). Starting from the first frame.";
+    } else if (!ReadCheckpoint(checkpoint_path, checkpoint)) {
+      LOG(WARNING) << "No checkpoint found at " << checkpoint_path
+                   << ". Starting from the first frame.";
+    } else if (!stream_writer.Resume(save_path, checkpoint.stream_bytes)) {
+      // the stream is rewritten from the start when the writer is opened
+      LOG(WARNING) << "Can not resume " << save_path
+                   << ". Starting from the first frame.";
+    } else {
+      start_video_frame = checkpoint.video_frame + 1;
+      LOG(INFO) << "Resuming extraction at frame " << start_video_frame
+                << " (" << checkpoint.timestamp_s << "s).";
     }
+  }
 
-    const double timstamp_s = input_video.get(cv::CAP_PROP_POS_MSEC) * 1e-3;
-    const std::string view_us = std::to_string(timstamp_s * S_TO_US);
-    ++frame_cnt;
+  const int total_nr_frames =
+      image_sequence ? static_cast<int>(image_paths.size())
+                     : input_video.get(cv::CAP_PROP_FRAME_COUNT);
+  const int num_workers = std::max(1, num_threads);
+  LOG(INFO) << "Extracting corners with " << num_workers
+            << " detection threads from " << (decoded.gray ? "gray" : "BGR")
+            << " frames"
+            << (decoded.downsample_factor > 1.0 ? " downsampled by the decoder."
+                                                : ".");
 
-    const double fxfy = 1. / img_downsample_factor;
-    cv::resize(image, image, cv::Size(), fxfy, fxfy);
+  // Pipeline: decoder thread(s) -> detection workers -> ordered writer.
+  // Frame indices are assigned by the decoders without gaps, so the writer can
+  // put the views back into decoding order.
+  // tracking needs consecutive frames in the same worker
+  FrameDispatcher frame_queue(num_workers,
+                              roi_tracking_ ? kTrackingRunFrames : 1);
+  BoundedQueue<FrameResult> result_queue(4 * num_workers);
+  const bool measure_quality = record_view_quality_ || min_sharpness_ > 0.0 ||
+                               max_saturated_fraction_ < 1.0;
 
-    aligned_vector<Eigen::Vector2d> corners;
-    std::vector<int> ids;
-    ExtractBoard(image, corners, ids);
+  const auto start_time = std::chrono::steady_clock::now();
+
+  // GOP-parallel decoding: every decoder owns a capture and decodes whole
+  // keyframe aligned chunks. Frame indices are the absolute frame numbers, so
+  // the merged output is the same as for a single decoder.
+  std::vector<std::pair<int, int>> chunks;
+  if (image_sequence) {
+    // images are decoded in parallel by all workers
+    for (int start = start_video_frame; start < total_nr_frames;
+         start += kImageChunkFrames) {
+      chunks.push_back(std::make_pair(
+          start, std::min(start + kImageChunkFrames, total_nr_frames)));
+    }
+    LOG(INFO) << "Decoding " << total_nr_frames << " images with "
+              << num_workers << " decoders.";
+  } else if (num_decoders_ > 1 && decoded.gstreamer) {
+    LOG(WARNING) << "GStreamer pipelines can not seek reliably. Decoding "
+                 << video_path << " with a single decoder.";
+  } else if (num_decoders_ > 1) {
+    // chunks are in presentation order, the order in which the captures
+    // number and seek frames
+    io::MP4FrameIndex frame_index;
+    if (io::ReadMP4KeyframeIndex(video_path, frame_index)) {
+      chunks = io::KeyframeAlignedChunks(frame_index.nr_frames,
+                                         frame_index.keyframes,
+                                         kMinDecodeChunkFrames);
+      LOG(INFO) << "Decoding " << frame_index.nr_frames << " frames in "
+                << chunks.size() << " keyframe aligned chunks with "
+                << num_decoders_ << " decoders"
+                << (frame_index.reordered ? " (B-frames)." : ".");
+    } else {
+      LOG(WARNING) << "Could not read keyframe index of " << video_path
+                   << ". Falling back to a single decoder.";
+    }
+    // drop everything that was already extracted before a resume
+    std::vector<std::pair<int, int>> remaining_chunks;
+    for (const auto &chunk : chunks) {
+      if (chunk.second > start_video_frame) {
+        remaining_chunks.push_back(std::make_pair(
+            std::max(chunk.first, start_video_frame), chunk.second));
+      }
+    }
+    chunks = remaining_chunks;
+  }
 
-    for (size_t c = 0; c < ids.size(); ++c) {
-      output_json["views"][view_us]["image_points"][std::to_string(ids[c])] = {
-          corners[c][0], corners[c][1]};
+  std::atomic<int> next_chunk(0);
+  std::atomic<int> active_decoders(0);
+  std::atomic<int> skipped_frames(0);
+  // set by the writer once the coverage targets are met
+  std::atomic<bool> stop_decoding(false);
+  std::atomic<int> sparse_stride(1);
+  std::atomic<int> sparse_skipped_frames(0);
+  auto sparse_skip = [&](const int video_frame) {
+    const int stride = sparse_stride;
+    if (stride > 1 && video_frame % stride != 0) {
+      ++sparse_skipped_frames;
+      return true;
     }
-    if (!set_img_size) {
-      output_json["image_width"] = image.cols;
-      output_json["image_height"] = image.rows;
-      set_img_size = true;
+    return false;
+  };
+  // The writer only consumes frames in order, everything that arrives early
+  // waits in its reorder buffer. Chunk decoders therefore wait before chunk c
+  // until the writer is done with chunk c - lead_chunks, which bounds the
+  // buffer to about lead_chunks chunks.
+  std::mutex writer_progress_mutex;
+  std::condition_variable writer_progress;
+  int written_frame_idx = chunks.empty() ? 0 : chunks.front().first;
+  auto wait_for_writer = [&](const int c, const int lead_chunks) {
+    if (c < lead_chunks) {
+      return;
+    }
+    const int frame_idx = chunks[c - lead_chunks].second;
+    std::unique_lock<std::mutex> lock(writer_progress_mutex);
+    writer_progress.wait(lock, [&] {
+      return written_frame_idx >= frame_idx || stop_decoding;
+    });
+  };
+  // Parallel decoders compare the motion only within their chunks, which
+  // would keep other frames than a sequential run
+  const bool parallel_decoding =
+      chunks.size() > 1 && (image_sequence ? num_workers : num_decoders_) > 1;
+  LOG_IF(WARNING, parallel_decoding && min_motion > 0.0)
+      << "The motion check needs sequential decoding, ignoring the minimum "
+         "frame motion of "
+      << video_path << ".";
+  // shared by all decoders, such that the rate limit holds for the video
+  FrameSkipFilter skip_filter(parallel_decoding ? 0.0 : min_motion,
+                              max_rate_hz);
+  std::vector<std::thread> decoders;
+  if (image_sequence) {
+    const int num_decoders =
+        std::min(num_workers, static_cast<int>(chunks.size()));
+    active_decoders = num_decoders;
+    for (int d = 0; d < num_decoders; ++d) {
+      decoders.emplace_back([&]() {
+        const int imread_flags =
+            gray_decoding_ ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+        cv::Mat motion_reference;
+        for (int c = next_chunk++;
+             c < static_cast<int>(chunks.size()) && !stop_decoding;
+             c = next_chunk++) {
+          wait_for_writer(c, num_decoders);
+          motion_reference.release();
+          // unreadable images are passed on as empty frames
+          for (int f = chunks[c].first; f < chunks[c].second && !stop_decoding;
+               ++f) {
+            FramePacket packet;
+            packet.frame_idx = f;
+            packet.video_frame = f;
+            packet.timestamp_s = image_timestamps_s[f];
+            if (sparse_skip(f)) {
+              frame_queue.Push(std::move(packet));
+              continue;
+            }
+            const auto read_start = std::chrono::steady_clock::now();
+            packet.image = cv::imread(image_paths[f], imread_flags);
+            packet.decode_ms = std::chrono::duration<float, std::milli>(
+                                   std::chrono::steady_clock::now() -
+                                   read_start)
+                                   .count();
+            if (packet.image.empty()) {
+              LOG(WARNING) << "Could not read " << image_paths[f];
+            } else if (skip_filter.Skip(packet.image, packet.timestamp_s,
+                                        motion_reference)) {
+              ++skipped_frames;
+              packet.image.release();
+            }
+            frame_queue.Push(std::move(packet));
+          }
+        }
+        if (--active_decoders == 0) {
+          frame_queue.Close();
+        }
+      });
+    }
+  } else if (chunks.empty()) {
+    decoders.emplace_back([&]() {
+      cv::Mat motion_reference;
+      int cnt_wrong = 0;
+      int frame_idx = 0;
+      int video_frame = start_video_frame;
+      if (start_video_frame > 0 && decoded.gstreamer) {
+        // GStreamer pipelines can not seek reliably, the frames are skipped
+        for (int f = 0; f < start_video_frame && input_video.grab(); ++f) {
+        }
+      } else if (start_video_frame > 0) {
+        input_video.set(cv::CAP_PROP_POS_FRAMES, start_video_frame);
+      }
+      while (!stop_decoding) {
+        if (sparse_skip(video_frame)) {
+          // only demuxed, the frame is not needed
+          if (!input_video.grab()) {
+            break;
+          }
+          ++video_frame;
+          continue;
+        }
+        FramePacket packet;
+        const auto read_start = std::chrono::steady_clock::now();
+        // a failed read still uses up a frame number, like in the chunk
+        // decoders
+        if (!input_video.read(packet.image)) {
+          ++video_frame;
+          cnt_wrong++;
+          if (cnt_wrong > 500)
+            break;
+          continue;
+        }
+        packet.decode_ms = std::chrono::duration<float, std::milli>(
+                               std::chrono::steady_clock::now() - read_start)
+                               .count();
+        packet.video_frame = video_frame++;
+        packet.downsampled = decoded.downsample_factor > 1.0;
+        packet.timestamp_s =
+            input_video.get(cv::CAP_PROP_POS_MSEC) * MS_TO_S;
+        if (skip_filter.Skip(packet.image, packet.timestamp_s,
+                             motion_reference)) {
+          ++skipped_frames;
+          continue;
+        }
+        packet.frame_idx = frame_idx++;
+        if (!frame_queue.Push(std::move(packet))) {
+          break;
+        }
+      }
+      frame_queue.Close();
+    });
+  } else {
+    input_video.release();
+    const int num_decoders =
+        std::min(num_decoders_, static_cast<int>(chunks.size()));
+    active_decoders = num_decoders;
+    for (int d = 0; d < num_decoders; ++d) {
+      decoders.emplace_back([&]() {
+        VideoCapture chunk_video;
+        io::VideoDecodeOptions chunk_decoded;
+        io::OpenVideoCapture(video_path, decode_options, chunk_video,
+                             chunk_decoded);
+        cv::Mat motion_reference;
+        int position = 0;
+        for (int c = next_chunk++;
+             c < static_cast<int>(chunks.size()) && !stop_decoding;
+             c = next_chunk++) {
+          wait_for_writer(c, num_decoders);
+          const int chunk_start = chunks[c].first;
+          const int chunk_end = chunks[c].second;
+          motion_reference.release();
+          if (position != chunk_start) {
+            chunk_video.set(cv::CAP_PROP_POS_FRAMES, chunk_start);
+            const int seeked_frame =
+                cvRound(chunk_video.get(cv::CAP_PROP_POS_FRAMES));
+            LOG_IF(WARNING, seeked_frame != chunk_start)
+                << "Seeking to frame " << chunk_start << " of " << video_path
+                << " ended at frame " << seeked_frame
+                << ". Frame numbers differ from a sequential run.";
+          }
+          // every frame index has to reach the writer, failed reads are
+          // passed on as empty frames
+          for (int f = chunk_start; f < chunk_end && !stop_decoding; ++f) {
+            FramePacket packet;
+            packet.frame_idx = f;
+            packet.video_frame = f;
+            packet.downsampled = chunk_decoded.downsample_factor > 1.0;
+            if (sparse_skip(f)) {
+              chunk_video.grab();
+              frame_queue.Push(std::move(packet));
+              continue;
+            }
+            const auto read_start = std::chrono::steady_clock::now();
+            if (chunk_video.read(packet.image)) {
+              packet.decode_ms = std::chrono::duration<float, std::milli>(
+                                     std::chrono::steady_clock::now() -
+                                     read_start)
+                                     .count();
+              packet.timestamp_s =
+                  chunk_video.get(cv::CAP_PROP_POS_MSEC) * MS_TO_S;
+              if (skip_filter.Skip(packet.image, packet.timestamp_s,
+                                   motion_reference)) {
+                ++skipped_frames;
+                packet.image.release();
+              }
+            }
+            frame_queue.Push(std::move(packet));
+          }
+          position = chunk_end;
+        }
+        if (--active_decoders == 0) {
+          frame_queue.Close();
+        }
+      });
     }
+  }
 
-    LOG_IF(INFO, frame_cnt % 60 == 0)
-        << "Extracting corners from frame " << frame_cnt << " / "
-        << total_nr_frames << "\n";
+  std::mutex stats_mutex;
+  RoiTrackingStats tracking_stats;
+  std::atomic<int> active_workers(num_workers);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < num_workers; ++w) {
+    workers.emplace_back([&, w]() {
+      DetectorState state = CloneDetectorState();
+      const double fxfy = 1. / img_downsample_factor;
+      FramePacket packet;
+      while (frame_queue.Pop(w, packet)) {
+        FrameResult result;
+        result.frame_idx = packet.frame_idx;
+        result.video_frame = packet.video_frame;
+        result.timestamp_s = packet.timestamp_s;
+        // frames that were queued before the coverage targets were met
+        if (packet.image.empty() || stop_decoding) {
+          result_queue.Push(std::move(result));
+          continue;
+        }
+        cv::Mat image, detect_image;
+        state.frame_idx = packet.frame_idx;
+        state.stage_ms.fill(0.f);
+        state.stage_ms[static_cast<int>(ExtractionStage::DECODE)] =
+            packet.decode_ms;
+        {
+          ScopedStageTimer timer(state.stage_ms, ExtractionStage::RESIZE);
+          if (coarse_to_fine_) {
+            // detect on a coarse level, refine corners on the full image
+            cv::resize(packet.image, detect_image, cv::Size(), fxfy, fxfy,
+                       cv::INTER_AREA);
+            image = packet.image;
+          } else {
+            if (packet.downsampled) {
+              image = packet.image;
+            } else {
+              cv::resize(packet.image, image, cv::Size(), fxfy, fxfy);
+            }
+            detect_image = image;
+          }
+        }
+        // blurred or overexposed frames only give poor corners
+        if (measure_quality) {
+          ScopedStageTimer timer(state.stage_ms, ExtractionStage::QUALITY);
+          result.quality = ComputeViewQuality(detect_image);
+          result.rejected =
+              result.quality.sharpness < min_sharpness_ ||
+              result.quality.saturated_fraction > max_saturated_fraction_;
+        }
+        if (!result.rejected) {
+          ExtractBoard(detect_image, image,
+                       static_cast<double>(image.cols) / detect_image.cols,
+                       state, result.corners, result.ids);
+        }
+        result.image_size = image.size();
+        result.stage_ms = state.stage_ms;
+        if (plot) {
+          result.image = image;
+        }
+        result_queue.Push(std::move(result));
+      }
+      {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        tracking_stats.roi_attempts += state.tracking_stats.roi_attempts;
+        tracking_stats.roi_hits += state.tracking_stats.roi_hits;
+        tracking_stats.roi_time_ms += state.tracking_stats.roi_time_ms;
+        tracking_stats.full_frames += state.tracking_stats.full_frames;
+        tracking_stats.full_time_ms += state.tracking_stats.full_time_ms;
+      }
+      // last worker to finish closes the result queue
+      if (--active_workers == 0) {
+        result_queue.Close();
+      }
+    });
+  }
 
-    if (verbose_plot_) {
-      for (int i = 0; i < corners.size(); ++i) {
-        cv::drawMarker(
-            image, cv::Point(cvRound(corners[i][0]), cvRound(corners[i][1])),
-            cv::Scalar(0, 0, 255), cv::MARKER_CROSS, 10, 3);
+  // the display or video encoding must not throttle the extraction
+  std::unique_ptr<utils::AsyncVisualizer> visualizer;
+  if (plot) {
+    visualizer.reset(
+        new utils::AsyncVisualizer("corners", verbose_plot_video_, fps));
+  }
+  ExtractionTimings timings;
+  // views are added in frame order, the coverage is built with the image size
+  // of the first frame
+  std::unique_ptr<BoardCoverage> coverage;
+  const bool track_coverage = coverage_map_ || coverage_targets_.Enabled();
+  int coverage_met_frame = -1;
+  double coverage_met_s = 0.0;
+  std::map<int, FrameResult> reorder_buffer;
+  int next_frame_idx = chunks.empty() ? 0 : chunks.front().first;
+  int frame_cnt = 0;
+  int frames_with_corners = 0;
+  int rejected_frames = 0;
+  // a resumed stream already contains the header
+  bool set_img_size = stream_writer.IsOpen();
+  // the output is incomplete and the checkpoint is kept
+  bool stream_write_failed = false;
+  auto last_checkpoint_time = std::chrono::steady_clock::now();
+  FrameResult popped;
+  while (result_queue.Pop(popped)) {
+    reorder_buffer[popped.frame_idx] = std::move(popped);
+    for (auto it = reorder_buffer.find(next_frame_idx);
+         it != reorder_buffer.end();
+         it = reorder_buffer.find(next_frame_idx)) {
+      const FrameResult &result = it->second;
+      if (result.image_size.area() == 0) {
+        reorder_buffer.erase(it);
+        ++next_frame_idx;
+        continue;
+      }
+      // all frames up to this one are on disk now
+      if (stream_output && !stream_write_failed &&
+          checkpoint_interval_s_ > 0.0 &&
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        last_checkpoint_time)
+                  .count() > checkpoint_interval_s_) {
+        ExtractionCheckpoint checkpoint;
+        checkpoint.video_frame = result.video_frame - 1;
+        checkpoint.timestamp_s = result.timestamp_s;
+        checkpoint.stream_bytes = stream_writer.BytesWritten();
+        // the checkpoint must not point behind the views on disk
+        if (!stream_writer.IsOpen() || stream_writer.Sync()) {
+          LOG_IF(WARNING, !WriteCheckpoint(checkpoint_path, video_path,
+                                           checkpoint))
+              << "Could not write checkpoint " << checkpoint_path;
+        } else {
+          LOG(WARNING) << "Could not sync " << save_path
+                       << ", skipping the checkpoint.";
+        }
+        last_checkpoint_time = std::chrono::steady_clock::now();
+      }
+      const aligned_vector<Eigen::Vector2d> &corners = result.corners;
+      const std::vector<int> &ids = result.ids;
+      ++frame_cnt;
 
-        cv::putText(image, std::to_string(ids[i]),
-                    cv::Point(cvRound(corners[i][0]), cvRound(corners[i][1])),
-                    cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(0, 0, 255));
+      if (!set_img_size) {
+        output_json["image_width"] = result.image_size.width;
+        output_json["image_height"] = result.image_size.height;
+        stream_header.image_width = result.image_size.width;
+        stream_header.image_height = result.image_size.height;
+        if (stream_output) {
+          CHECK(stream_writer.Open(save_path, stream_header))
+              << "Could not open " << save_path;
+        }
+        set_img_size = true;
       }
-      cv::putText(image, "Number corners: " + std::to_string(corners.size()),
-                  cv::Point(10, 20), cv::FONT_HERSHEY_COMPLEX_SMALL, 2,
-                  cv::Scalar(0, 0, 255));
-      cv::imshow("corners", image);
-      cv::waitKey(1);
+      if (track_coverage && !coverage) {
+        std::map<int, cv::Point2f> coverage_board_pts;
+        for (size_t i = 0; i < stream_header.scene_pt_ids.size(); ++i) {
+          coverage_board_pts[stream_header.scene_pt_ids[i]] =
+              cv::Point2f(stream_header.scene_pts[i][0],
+                          stream_header.scene_pts[i][1]);
+        }
+        coverage.reset(
+            new BoardCoverage(result.image_size, coverage_board_pts));
+      }
+      StageTimes stage_ms = result.stage_ms;
+      {
+        ScopedStageTimer timer(stage_ms, ExtractionStage::OUTPUT);
+        if (stream_output) {
+          if (!ids.empty() && !stream_write_failed &&
+              !stream_writer.WriteView(result.timestamp_s * S_TO_US, ids,
+                                       corners, result.quality)) {
+            LOG(ERROR) << "Could not write to " << save_path
+                       << ". Stopping the extraction.";
+            stream_write_failed = true;
+            stop_decoding = true;
+          }
+        } else {
+          const std::string view_us =
+              std::to_string(result.timestamp_s * S_TO_US);
+          for (size_t c = 0; c < ids.size(); ++c) {
+            output_json["views"][view_us]["image_points"]
+                       [std::to_string(ids[c])] = {corners[c][0],
+                                                   corners[c][1]};
+          }
+          if (!ids.empty() && measure_quality) {
+            output_json["views"][view_us]["sharpness"] =
+                result.quality.sharpness;
+            output_json["views"][view_us]["saturated_fraction"] =
+                result.quality.saturated_fraction;
+          }
+        }
+      }
+      timings.AddFrame(result.video_frame, result.timestamp_s, !ids.empty(),
+                       stage_ms);
+      if (coverage && !ids.empty()) {
+        coverage->AddView(corners, ids);
+        if (coverage_targets_.Enabled() && coverage_met_frame < 0 &&
+            coverage->TargetsMet(coverage_targets_)) {
+          coverage_met_frame = result.video_frame;
+          coverage_met_s = result.timestamp_s;
+          LOG(INFO) << "Coverage targets met at frame " << coverage_met_frame
+                    << " (" << coverage_met_s << "s) after "
+                    << coverage->NumViews() << " views.";
+          if (coverage_sparse_stride_ > 1) {
+            sparse_stride = coverage_sparse_stride_;
+          } else {
+            stop_decoding = true;
+          }
+        }
+      }
+      if (!ids.empty()) {
+        ++frames_with_corners;
+      }
+      if (result.rejected) {
+        ++rejected_frames;
+        LOG(INFO) << "Skipped detection in frame " << result.video_frame
+                  << " (" << result.timestamp_s << "s): "
+                  << (result.quality.sharpness < min_sharpness_
+                          ? "blurred"
+                          : "overexposed")
+                  << ", sharpness " << result.quality.sharpness
+                  << ", saturated fraction "
+                  << result.quality.saturated_fraction << ".";
+      }
+
+      LOG_IF(INFO, frame_cnt % 60 == 0)
+          << "Extracting corners from frame " << frame_cnt << " / "
+          << total_nr_frames << "\n";
+
+      if (visualizer) {
+        // drawing happens on the visualizer thread
+        visualizer->Show(result.image, [corners, ids](cv::Mat &image) {
+          for (int i = 0; i < corners.size(); ++i) {
+            const cv::Point pt(cvRound(corners[i][0]), cvRound(corners[i][1]));
+            cv::drawMarker(image, pt, cv::Scalar(0, 0, 255), cv::MARKER_CROSS,
+                           10, 3);
+            cv::putText(image, std::to_string(ids[i]), pt,
+                        cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(0, 0, 255));
+          }
+          cv::putText(image,
+                      "Number corners: " + std::to_string(corners.size()),
+                      cv::Point(10, 20), cv::FONT_HERSHEY_COMPLEX_SMALL, 2,
+                      cv::Scalar(0, 0, 255));
+        });
+      }
+      reorder_buffer.erase(it);
+      ++next_frame_idx;
+    }
+    {
+      std::lock_guard<std::mutex> lock(writer_progress_mutex);
+      written_frame_idx = next_frame_idx;
     }
+    writer_progress.notify_all();
+  }
+
+  for (auto &decoder : decoders) {
+    decoder.join();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  const double elapsed_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    start_time)
+          .count();
+  if (visualizer) {
+    visualizer->Close();
+  }
+  LOG(INFO) << "Extracted corners from " << frame_cnt << " frames in "
+            << elapsed_s << "s (" << frame_cnt / std::max(elapsed_s, 1e-9)
+            << " frames/s, " << num_workers << " threads). Board found in "
+            << frames_with_corners << " frames.";
+  if (skip_filter.Enabled()) {
+    LOG(INFO) << "Skipped " << skipped_frames
+              << " frames without enough motion or above the maximum "
+                 "extraction rate.";
+  }
+  if (min_sharpness_ > 0.0 || max_saturated_fraction_ < 1.0) {
+    LOG(INFO) << "Skipped detection in " << rejected_frames
+              << " blurred or overexposed frames.";
+  }
+  timings.LogSummary(elapsed_s);
+  if (coverage_sparse_stride_ > 1 && sparse_skipped_frames > 0) {
+    LOG(INFO) << "Skipped " << sparse_skipped_frames
+              << " frames after the coverage targets were met.";
+  }
+  if (coverage) {
+    LOG(INFO) << "Board corners cover " << 100.0 * coverage->CellFraction()
+              << "% of the image, views in " << coverage->NumPoseBins(1)
+              << " of " << BoardCoverage::kNumPoseBins << " pose bins.";
+    nlohmann::json coverage_json = coverage->ToJson();
+    coverage_json["targets"]["min_cell_fraction"] =
+        coverage_targets_.min_cell_fraction;
+    coverage_json["targets"]["min_pose_bins"] = coverage_targets_.min_pose_bins;
+    coverage_json["targets"]["min_views_per_pose_bin"] =
+        coverage_targets_.min_views_per_pose_bin;
+    coverage_json["targets_met"] = coverage_met_frame >= 0;
+    if (coverage_met_frame >= 0) {
+      coverage_json["targets_met_frame"] = coverage_met_frame;
+      coverage_json["targets_met_s"] = coverage_met_s;
+    }
+    const std::string coverage_path = CoveragePath(save_path);
+    std::ofstream coverage_file(coverage_path);
+    coverage_file << coverage_json.dump(2);
+    LOG_IF(WARNING, !coverage_file.good())
+        << "Could not write coverage map " << coverage_path;
+  }
+  if (write_timing_csv_) {
+    const std::string csv_path = TimingCsvPath(save_path);
+    if (timings.WriteCsv(csv_path)) {
+      LOG(INFO) << "Wrote stage timings to " << csv_path;
+    }
+  }
+  if (roi_tracking_) {
+    const RoiTrackingStats &ts = tracking_stats;
+    const double full_ms_per_frame =
+        ts.full_frames > 0 ? ts.full_time_ms / ts.full_frames : 0.0;
+    // a hit replaces a full frame search, a miss adds the roi search on top
+    const double saved_ms =
+        ts.roi_hits * full_ms_per_frame - ts.roi_time_ms;
+    LOG(INFO) << "Tracking hit rate: " << ts.roi_hits << " / "
+              << ts.roi_attempts << " ("
+              << 100.0 * ts.roi_hits / std::max(1, ts.roi_attempts)
+              << "%). Full frame detection: " << full_ms_per_frame
+              << "ms/frame, tracking: "
+              << ts.roi_time_ms / std::max(1, ts.roi_attempts)
+              << "ms/frame. Saved " << saved_ms / std::max(1, frame_cnt)
+              << "ms per frame.";
+  }
+
+  if (stream_output) {
+    if (!stream_writer.IsOpen() &&
+        !stream_writer.Open(save_path, stream_header)) {
+      return false;
+    }
+    if (!stream_writer.Close() || stream_write_failed) {
+      LOG(ERROR) << "Corner stream " << save_path << " is incomplete.";
+      return false;
+    }
+    // extraction finished, nothing to resume
+    std::remove(checkpoint_path.c_str());
+    return true;
   }
 
   std::vector<std::uint8_t> v_bson = nlohmann::json::to_ubjson(output_json);
@@ -246,6 +1688,11 @@ bool BoardExtractor::ExtractVideoToJson(const std::string &video_path,
   std::ofstream calib_txt_output(save_path, std::ios::out | std::ios::binary);
   calib_txt_output.write(reinterpret_cast<const char *>(&v_bson[0]),
                          v_bson.size() * sizeof(std::uint8_t));
+  if (!calib_txt_output.good()) {
+    LOG(ERROR) << "Could not write " << save_path;
+    return false;
+  }
+  return true;
 }
 
 } // namespace core
@@ -39,6 +39,7 @@
 #include "OpenCameraCalibrator/io/write_camera_calibration.h"
 #include "OpenCameraCalibrator/utils/intrinsic_initializer.h"
 #include "OpenCameraCalibrator/utils/json.h"
+#include "OpenCameraCalibrator/utils/timestamp_view_index.h"
 #include "OpenCameraCalibrator/utils/types.h"
 #include "OpenCameraCalibrator/utils/utils.h"
 
@@ -86,7 +87,8 @@ theia::ViewId CameraCalibrator::AddView(
     const int &image_height, const double &timestamp_s,
     const theia::CameraIntrinsicsGroupId group_id) {
   // fill charucoCorners to theia reconstruction
-  std::string view_name = std::to_string((uint64_t)(timestamp_s * S_TO_US));
+  const std::string view_name =
+      utils::ViewNameFromTimestampNs(utils::TimestampSToNs(timestamp_s));
   theia::ViewId view_id =
       recon_calib_dataset_.AddView(view_name, group_id, timestamp_s);
   theia::View *theia_view = recon_calib_dataset_.MutableView(view_id);
@@ -209,30 +211,37 @@ bool CameraCalibrator::RunCalibration() {
 
 bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json &scene_json,
                                                const std::string &output_path) {
+  io::CornerDataset dataset;
+  if (!dataset.FromJson(scene_json)) {
+    return false;
+  }
+  return CalibrateCamera(dataset, output_path);
+}
 
-  io::scene_points_to_calib_dataset(scene_json, recon_calib_dataset_);
+bool CameraCalibrator::CalibrateCamera(const io::CornerDataset &dataset,
+                                       const std::string &output_path) {
 
-  const int image_width = scene_json["image_width"];
-  const int image_height = scene_json["image_height"];
+  io::scene_points_to_calib_dataset(dataset, recon_calib_dataset_);
+
+  const int image_width = dataset.Header().image_width;
+  const int image_height = dataset.Header().image_height;
   // initial principal point
   const double px = static_cast<double>(image_width) / 2.0;
   const double py = static_cast<double>(image_height) / 2.0;
 
   vec3_vector saved_poses;
   // iterate views and estimate poses
-  const auto views = scene_json["views"];
-  const size_t total_nr_views = views.size();
+  const size_t total_nr_views = dataset.NumViews();
   int views_initialized = 0;
-  for (const auto &view : views.items()) {
-    const double timestamp_us = std::stod(view.key()); // to seconds
-    const double timestamp_s = timestamp_us * 1e-6;    // to seconds
-    const auto image_points = view.value()["image_points"];
-    std::vector<int> board_pt3_ids;
-    aligned_vector<Eigen::Vector2d> corners;
-    for (const auto &img_pts : image_points.items()) {
-      board_pt3_ids.push_back(std::stoi(img_pts.key()));
-      corners.push_back(
-          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
+  std::vector<int> board_pt3_ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  for (size_t v = 0; v < dataset.NumViews(); ++v) {
+    const double timestamp_s = dataset.TimestampS(v);
+    board_pt3_ids.clear();
+    corners.clear();
+    for (size_t c = dataset.ViewBegin(v); c < dataset.ViewEnd(v); ++c) {
+      board_pt3_ids.push_back(dataset.PointId(c));
+      corners.push_back(dataset.Corner(c));
     }
 
     LOG(INFO) << "Initializing view at timestamp: " << timestamp_s << "\n";
@@ -325,10 +334,11 @@ bool CameraCalibrator::CalibrateCameraFromJson(const nlohmann::json &scene_json,
     theia::WriteReconstruction(recon_calib_dataset_,
                                output_path + ".calibdata");
     CHECK(io::write_camera_calibration(
-        output_path + ".json", cam, scene_json["camera_fps"],
+        output_path + ".json", cam, dataset.Header().camera_fps,
         recon_calib_dataset_.NumViews(), total_repro_error))
         << "Could not write calibration file.\n";
   }
+  return true;
 }
 
 void CameraCalibrator::PrintResult() {
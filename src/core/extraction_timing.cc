@@ -0,0 +1,154 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/core/extraction_timing.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+//! Value at quantile q of sorted values (nearest rank)
+float Quantile(const std::vector<float> &sorted, const double q) {
+  if (sorted.empty()) {
+    return 0.f;
+  }
+  const size_t idx = std::min(
+      sorted.size() - 1, static_cast<size_t>(q * (sorted.size() - 1) + 0.5));
+  return sorted[idx];
+}
+
+void LogStage(const std::string &name, std::vector<float> &values,
+              const size_t num_frames) {
+  if (values.empty()) {
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  double total_ms = 0.0;
+  for (const float v : values) {
+    total_ms += v;
+  }
+  char line[160];
+  std::snprintf(line, sizeof(line),
+                "%-22s %7zu/%-7zu p50 %8.3f  p95 %8.3f  max %8.3f  total "
+                "%9.1f ms",
+                name.c_str(), values.size(), num_frames, Quantile(values, 0.5),
+                Quantile(values, 0.95), values.back(), total_ms);
+  LOG(INFO) << line;
+}
+
+} // namespace
+
+const char *ExtractionStageName(const ExtractionStage stage) {
+  switch (stage) {
+  case ExtractionStage::DECODE:
+    return "decode";
+  case ExtractionStage::RESIZE:
+    return "resize";
+  case ExtractionStage::QUALITY:
+    return "quality";
+  case ExtractionStage::DETECT_MARKERS:
+    return "detect_markers";
+  case ExtractionStage::THRESHOLD_WARMUP:
+    return "threshold_warmup";
+  case ExtractionStage::REFINE_MARKERS:
+    return "refine_markers";
+  case ExtractionStage::INTERPOLATE_CORNERS:
+    return "interpolate_corners";
+  case ExtractionStage::CHESSBOARD_DETECTION:
+    return "chessboard_detection";
+  case ExtractionStage::REFINE_CORNERS:
+    return "refine_corners";
+  case ExtractionStage::OUTPUT:
+    return "output";
+  default:
+    return "unknown";
+  }
+}
+
+void ExtractionTimings::AddFrame(const int video_frame,
+                                 const double timestamp_s,
+                                 const bool found_board,
+                                 const StageTimes &stage_ms) {
+  frames_.push_back(FrameTiming{video_frame, timestamp_s, found_board,
+                                stage_ms});
+}
+
+void ExtractionTimings::LogSummary(const double elapsed_s) const {
+  if (frames_.empty()) {
+    return;
+  }
+  int frames_with_board = 0;
+  std::vector<float> total;
+  total.reserve(frames_.size());
+  for (const auto &frame : frames_) {
+    frames_with_board += frame.found_board;
+    float sum = 0.f;
+    for (const float ms : frame.stage_ms) {
+      sum += ms;
+    }
+    total.push_back(sum);
+  }
+  LOG(INFO) << "Stage timings of " << frames_.size() << " frames: "
+            << frames_.size() / std::max(elapsed_s, 1e-9)
+            << " frames/s, board found in "
+            << 100.0 * frames_with_board / frames_.size() << "% of frames.";
+  // stages that did not run on a frame are not part of its statistics
+  std::vector<float> values;
+  values.reserve(frames_.size());
+  for (int s = 0; s < kNumExtractionStages; ++s) {
+    values.clear();
+    for (const auto &frame : frames_) {
+      if (frame.stage_ms[s] > 0.f) {
+        values.push_back(frame.stage_ms[s]);
+      }
+    }
+    LogStage(ExtractionStageName(static_cast<ExtractionStage>(s)), values,
+             frames_.size());
+  }
+  LogStage("total", total, frames_.size());
+}
+
+bool ExtractionTimings::WriteCsv(const std::string &csv_path) const {
+  std::ofstream csv(csv_path);
+  if (!csv.is_open()) {
+    LOG(ERROR) << "Could not open " << csv_path << " for writing.";
+    return false;
+  }
+  csv.precision(10);
+  csv << "video_frame,timestamp_s,found_board";
+  for (int s = 0; s < kNumExtractionStages; ++s) {
+    csv << "," << ExtractionStageName(static_cast<ExtractionStage>(s))
+        << "_ms";
+  }
+  csv << "\n";
+  for (const auto &frame : frames_) {
+    csv << frame.video_frame << "," << frame.timestamp_s << ","
+        << frame.found_board;
+    for (const float ms : frame.stage_ms) {
+      csv << "," << ms;
+    }
+    csv << "\n";
+  }
+  return csv.good();
+}
+
+} // namespace core
+} // namespace OpenICC
@@ -15,6 +15,8 @@
 
 #include "OpenCameraCalibrator/core/imu_camera_calibrator.h"
 
+#include "OpenCameraCalibrator/utils/timestamp_view_index.h"
+
 using namespace theia;
 
 namespace OpenICC {
@@ -165,7 +167,7 @@ void ImuCameraCalibrator::ToTheiaReconDataset(Reconstruction &output_recon) {
     const int64_t t_ns = cam_timestamps_[i] * S_TO_NS;
     Sophus::SE3d spline_pose = trajectory_.getPose(t_ns);
     theia::ViewId v_id_theia =
-        output_recon.AddView(std::to_string(t_ns), 0, t_ns);
+        output_recon.AddView(utils::ViewNameFromTimestampNs(t_ns), 0, t_ns);
     theia::View *view = output_recon.MutableView(v_id_theia);
     view->SetEstimated(true);
     theia::Camera *camera = view->MutableCamera();
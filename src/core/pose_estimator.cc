@@ -16,6 +16,7 @@
 #include "OpenCameraCalibrator/core/pose_estimator.h"
 
 #include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/utils/timestamp_view_index.h"
 
 #include <theia/io/reconstruction_reader.h>
 #include <theia/io/reconstruction_writer.h>
@@ -89,31 +90,37 @@ bool PoseEstimator::EstimatePosePinhole(
 bool PoseEstimator::EstimatePosesFromJson(const nlohmann::json &scene_json,
                                           const theia::Camera camera,
                                           const double max_reproj_error) {
+  io::CornerDataset dataset;
+  if (!dataset.FromJson(scene_json)) {
+    return false;
+  }
+  return EstimatePoses(dataset, camera, max_reproj_error);
+}
+
+bool PoseEstimator::EstimatePoses(const io::CornerDataset &dataset,
+                                  const theia::Camera camera,
+                                  const double max_reproj_error) {
 
   const double image_diag =
       std::sqrt(camera.ImageWidth() * camera.ImageWidth() +
                 camera.ImageHeight() * camera.ImageHeight());
   ransac_params_.error_thresh =  max_reproj_error / image_diag;
   // get scene points and fill them into
-  io::scene_points_to_calib_dataset(scene_json, pose_dataset_);
+  io::scene_points_to_calib_dataset(dataset, pose_dataset_);
 
-  const auto views = scene_json["views"];
   double total_repro_error = 0.0;
   int processed_frames = 0;
 
-  for (const auto &view : views.items()) {
-    const double timestamp_us = std::stod(view.key());
-    const double timestamp_s = timestamp_us * 1e-6; // to seconds
-    const auto image_points = view.value()["image_points"];
+  for (size_t v = 0; v < dataset.NumViews(); ++v) {
+    const double timestamp_s = dataset.TimestampS(v);
     std::vector<int> board_pts3_ids;
     aligned_vector<Eigen::Vector2d> corners;
     std::vector<theia::FeatureCorrespondence2D3D> correspondences_undist;
 
-    for (const auto &img_pts : image_points.items()) {
-      const int board_pt3_id = std::stoi(img_pts.key());
-      board_pts3_ids.push_back(std::stoi(img_pts.key()));
-      const Eigen::Vector2d corner(
-          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
+    for (size_t c = dataset.ViewBegin(v); c < dataset.ViewEnd(v); ++c) {
+      const int board_pt3_id = dataset.PointId(c);
+      board_pts3_ids.push_back(board_pt3_id);
+      const Eigen::Vector2d corner = dataset.Corner(c);
       corners.push_back(corner);
       Eigen::Vector3d undist_pt = camera.PixelToNormalizedCoordinates(corner);
       undist_pt /= undist_pt[2];
@@ -131,7 +138,8 @@ bool PoseEstimator::EstimatePosesFromJson(const nlohmann::json &scene_json,
                 << "s. Not enough points found.";
       continue;
     }
-    std::string view_name = std::to_string((uint64_t)(timestamp_s * S_TO_US));
+    const std::string view_name =
+        utils::ViewNameFromTimestampNs(dataset.TimestampNs(v));
     theia::ViewId view_id = pose_dataset_.AddView(view_name, 0, timestamp_s);
 
     theia::Camera* cam = pose_dataset_.MutableView(view_id)->MutableCamera();
@@ -169,6 +177,7 @@ bool PoseEstimator::EstimatePosesFromJson(const nlohmann::json &scene_json,
     total_repro_error += repro_error_n;
     ++processed_frames;
   }
+  return true;
 }
 
 void PoseEstimator::OptimizeBoardPoints() {
@@ -0,0 +1,253 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/core/radon_board_tracker.h"
+#include "OpenCameraCalibrator/core/subpixel_refinement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <opencv2/imgproc.hpp>
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+//! Corners are searched within this fraction of the square size
+const float kSearchRadiusRatio = 0.4f;
+//! Minimum search radius in pixels, smaller boards are not tracked
+const float kMinSearchRadius = 2.f;
+//! Allowed deviation of a corner from the middle of its grid neighbours
+//! relative to the square size
+const float kGridTolerance = 0.25f;
+//! Fraction of corners or cells that may fail the grid and color checks
+const double kMaxOutlierRatio = 0.05;
+//! Minimum gray value difference between black and white cells
+const float kMinCellContrast = 10.f;
+
+float SampleGray(const cv::Mat &gray, const cv::Point2f &pt) {
+  cv::Mat patch;
+  cv::getRectSubPix(gray, cv::Size(1, 1), pt, patch, CV_32F);
+  return patch.at<float>(0, 0);
+}
+
+} // namespace
+
+RadonBoardTracker::RadonBoardTracker(const cv::Size &pattern_size)
+    : pattern_size_(pattern_size) {}
+
+bool RadonBoardTracker::Track(const cv::Mat &image,
+                              const std::vector<cv::Point2f> &prev_corners,
+                              const cv::Mat &meta,
+                              std::vector<cv::Point2f> &corners) const {
+  // inner corners of the found grid, at least pattern_size_
+  const cv::Size grid_size =
+      meta.empty() ? pattern_size_ : cv::Size(meta.cols, meta.rows);
+  if (prev_corners.size() != static_cast<size_t>(grid_size.area())) {
+    return false;
+  }
+  cv::Mat gray = image;
+  if (image.channels() != 1) {
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+  }
+
+  const std::vector<float> neighbour_dists = NeighbourDistances(prev_corners, grid_size);
+  corners.resize(prev_corners.size());
+  for (size_t i = 0; i < prev_corners.size(); ++i) {
+    const float search_radius = kSearchRadiusRatio * neighbour_dists[i];
+    if (search_radius < kMinSearchRadius ||
+        !FindSaddlePoint(gray, prev_corners[i], search_radius, corners[i])) {
+      return false;
+    }
+  }
+
+  // sub-pixel refinement with a window well inside the squares
+  std::vector<float> sorted_dists = neighbour_dists;
+  std::nth_element(sorted_dists.begin(),
+                   sorted_dists.begin() + sorted_dists.size() / 2,
+                   sorted_dists.end());
+  const int win = std::max(
+      2, std::min(15, cvRound(0.25f * sorted_dists[sorted_dists.size() / 2])));
+  RefineCornersSubPix(gray, corners, win);
+
+  return CheckGrid(corners, grid_size) &&
+         CheckCellColors(gray, corners, meta, grid_size);
+}
+
+bool RadonBoardTracker::FindSaddlePoint(const cv::Mat &gray,
+                                        const cv::Point2f &prediction,
+                                        const float search_radius,
+                                        cv::Point2f &saddle) const {
+  // border for the derivative filters
+  const int border = 3;
+  const int half_size = cvCeil(search_radius) + border;
+  const cv::Rect patch_rect =
+      cv::Rect(cvRound(prediction.x) - half_size,
+               cvRound(prediction.y) - half_size, 2 * half_size + 1,
+               2 * half_size + 1) &
+      cv::Rect(0, 0, gray.cols, gray.rows);
+  if (patch_rect.width <= 2 * border || patch_rect.height <= 2 * border) {
+    return false;
+  }
+
+  cv::Mat patch, dxx, dyy, dxy;
+  gray(patch_rect).convertTo(patch, CV_32F);
+  cv::GaussianBlur(patch, patch, cv::Size(5, 5), 1.5);
+  cv::Sobel(patch, dxx, CV_32F, 2, 0, 3);
+  cv::Sobel(patch, dyy, CV_32F, 0, 2, 3);
+  cv::Sobel(patch, dxy, CV_32F, 1, 1, 3);
+
+  // the determinant of the Hessian is strongly negative at saddle points
+  const float radius_sq = search_radius * search_radius;
+  float min_det = 0.f;
+  cv::Point min_loc(-1, -1);
+  for (int y = border; y < patch.rows - border; ++y) {
+    for (int x = border; x < patch.cols - border; ++x) {
+      const float dx = patch_rect.x + x - prediction.x;
+      const float dy = patch_rect.y + y - prediction.y;
+      if (dx * dx + dy * dy > radius_sq) {
+        continue;
+      }
+      const float det = dxx.at<float>(y, x) * dyy.at<float>(y, x) -
+                        dxy.at<float>(y, x) * dxy.at<float>(y, x);
+      if (det < min_det) {
+        min_det = det;
+        min_loc = cv::Point(x, y);
+      }
+    }
+  }
+  if (min_loc.x < 0) {
+    return false;
+  }
+  saddle = cv::Point2f(patch_rect.x + min_loc.x, patch_rect.y + min_loc.y);
+  return true;
+}
+
+bool RadonBoardTracker::CheckGrid(const std::vector<cv::Point2f> &corners,
+                                  const cv::Size &grid_size) const {
+  const int cols = grid_size.width;
+  const int rows = grid_size.height;
+  int nr_outliers = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const cv::Point2f &c = corners[i * cols + j];
+      bool inlier = true;
+      if (j > 0 && j < cols - 1) {
+        const cv::Point2f &l = corners[i * cols + j - 1];
+        const cv::Point2f &r = corners[i * cols + j + 1];
+        inlier &= cv::norm(c - 0.5f * (l + r)) <
+                  kGridTolerance * 0.5f * cv::norm(r - l);
+      }
+      if (i > 0 && i < rows - 1) {
+        const cv::Point2f &t = corners[(i - 1) * cols + j];
+        const cv::Point2f &b = corners[(i + 1) * cols + j];
+        inlier &= cv::norm(c - 0.5f * (t + b)) <
+                  kGridTolerance * 0.5f * cv::norm(b - t);
+      }
+      nr_outliers += !inlier;
+    }
+  }
+  return nr_outliers <= kMaxOutlierRatio * corners.size();
+}
+
+bool RadonBoardTracker::CheckCellColors(const cv::Mat &gray,
+                                        const std::vector<cv::Point2f> &corners,
+                                        const cv::Mat &meta,
+                                        const cv::Size &grid_size) const {
+  if (meta.empty()) {
+    return true;
+  }
+  const int cols = grid_size.width;
+  // meta: 1, 3 left-top corner of a black cell, 2, 4 of a white cell
+  std::vector<float> cell_gray;
+  std::vector<bool> cell_black;
+  for (int i = 0; i < grid_size.height - 1; ++i) {
+    for (int j = 0; j < cols - 1; ++j) {
+      const int type = meta.at<uchar>(i, j);
+      if (type < 1 || type > 4) {
+        continue;
+      }
+      const cv::Point2f cell_corners[4] = {
+          corners[i * cols + j], corners[i * cols + j + 1],
+          corners[(i + 1) * cols + j], corners[(i + 1) * cols + j + 1]};
+      const cv::Point2f center = 0.25f * (cell_corners[0] + cell_corners[1] +
+                                          cell_corners[2] + cell_corners[3]);
+      // sample between the corners and the marker dot in the cell center
+      float sum = 0.f;
+      for (const auto &corner : cell_corners) {
+        sum += SampleGray(gray, corner + 0.35f * (center - corner));
+      }
+      cell_gray.push_back(0.25f * sum);
+      cell_black.push_back(type == 1 || type == 3);
+    }
+  }
+  if (cell_gray.empty()) {
+    return true;
+  }
+
+  float black_sum = 0.f, white_sum = 0.f;
+  int nr_black = 0;
+  for (size_t c = 0; c < cell_gray.size(); ++c) {
+    if (cell_black[c]) {
+      black_sum += cell_gray[c];
+      ++nr_black;
+    } else {
+      white_sum += cell_gray[c];
+    }
+  }
+  const int nr_white = cell_gray.size() - nr_black;
+  if (nr_black == 0 || nr_white == 0) {
+    return true;
+  }
+  const float black_mean = black_sum / nr_black;
+  const float white_mean = white_sum / nr_white;
+  if (white_mean - black_mean < kMinCellContrast) {
+    return false;
+  }
+  const float threshold = 0.5f * (black_mean + white_mean);
+  int nr_wrong = 0;
+  for (size_t c = 0; c < cell_gray.size(); ++c) {
+    nr_wrong += cell_black[c] != (cell_gray[c] < threshold);
+  }
+  return nr_wrong <= kMaxOutlierRatio * cell_gray.size();
+}
+
+std::vector<float> RadonBoardTracker::NeighbourDistances(
+    const std::vector<cv::Point2f> &corners, const cv::Size &grid_size) const {
+  const int cols = grid_size.width;
+  const int rows = grid_size.height;
+  std::vector<float> dists(corners.size(),
+                           std::numeric_limits<float>::max());
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const int idx = i * cols + j;
+      if (j + 1 < cols) {
+        const float d = cv::norm(corners[idx] - corners[idx + 1]);
+        dists[idx] = std::min(dists[idx], d);
+        dists[idx + 1] = std::min(dists[idx + 1], d);
+      }
+      if (i + 1 < rows) {
+        const float d = cv::norm(corners[idx] - corners[idx + cols]);
+        dists[idx] = std::min(dists[idx], d);
+        dists[idx + cols] = std::min(dists[idx + cols], d);
+      }
+    }
+  }
+  return dists;
+}
+
+} // namespace core
+} // namespace OpenICC
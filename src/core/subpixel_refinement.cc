@@ -0,0 +1,162 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/core/subpixel_refinement.h"
+
+#include <cfloat>
+#include <cmath>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+
+// VTraits replaces the nlanes constant since OpenCV 4.8, which also made the
+// universal intrinsics scalable (e.g. RISC-V vectors)
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 8)
+#define OPENICC_HAS_VTRAITS 1
+#else
+#define OPENICC_HAS_VTRAITS 0
+#endif
+
+namespace OpenICC {
+namespace core {
+
+namespace {
+
+//! Weighted gradient sums of one window
+struct GradientSums {
+  float a = 0.f, b = 0.f, c = 0.f, bb1 = 0.f, bb2 = 0.f;
+};
+
+//! Accumulates the gradient sums over the window. patch has a border of one
+//! pixel around the window for the central differences.
+GradientSums AccumulateGradients(const cv::Mat &patch, const cv::Mat &mask,
+                                 const std::vector<float> &offsets_x,
+                                 const int half_win) {
+  const int win = 2 * half_win + 1;
+  GradientSums sums;
+  for (int i = 0; i < win; ++i) {
+    const float *top = patch.ptr<float>(i);
+    const float *row = patch.ptr<float>(i + 1);
+    const float *bottom = patch.ptr<float>(i + 2);
+    const float *m = mask.ptr<float>(i);
+    const float py = static_cast<float>(i - half_win);
+    int j = 0;
+#if OPENICC_HAS_VTRAITS && (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 v_a = cv::vx_setzero_f32(), v_b = cv::vx_setzero_f32(),
+                  v_c = cv::vx_setzero_f32(), v_bb1 = cv::vx_setzero_f32(),
+                  v_bb2 = cv::vx_setzero_f32();
+    const cv::v_float32 v_py = cv::vx_setall_f32(py);
+    for (; j <= win - lanes; j += lanes) {
+      const cv::v_float32 gx =
+          cv::v_sub(cv::vx_load(row + j + 2), cv::vx_load(row + j));
+      const cv::v_float32 gy =
+          cv::v_sub(cv::vx_load(bottom + j + 1), cv::vx_load(top + j + 1));
+      const cv::v_float32 w = cv::vx_load(m + j);
+      const cv::v_float32 px = cv::vx_load(offsets_x.data() + j);
+      const cv::v_float32 gxx = cv::v_mul(cv::v_mul(gx, gx), w);
+      const cv::v_float32 gxy = cv::v_mul(cv::v_mul(gx, gy), w);
+      const cv::v_float32 gyy = cv::v_mul(cv::v_mul(gy, gy), w);
+      v_a = cv::v_add(v_a, gxx);
+      v_b = cv::v_add(v_b, gxy);
+      v_c = cv::v_add(v_c, gyy);
+      v_bb1 = cv::v_muladd(gxx, px, cv::v_muladd(gxy, v_py, v_bb1));
+      v_bb2 = cv::v_muladd(gxy, px, cv::v_muladd(gyy, v_py, v_bb2));
+    }
+    sums.a += cv::v_reduce_sum(v_a);
+    sums.b += cv::v_reduce_sum(v_b);
+    sums.c += cv::v_reduce_sum(v_c);
+    sums.bb1 += cv::v_reduce_sum(v_bb1);
+    sums.bb2 += cv::v_reduce_sum(v_bb2);
+#endif
+    for (; j < win; ++j) {
+      const float gx = row[j + 2] - row[j];
+      const float gy = bottom[j + 1] - top[j + 1];
+      const float gxx = gx * gx * m[j];
+      const float gxy = gx * gy * m[j];
+      const float gyy = gy * gy * m[j];
+      const float px = offsets_x[j];
+      sums.a += gxx;
+      sums.b += gxy;
+      sums.c += gyy;
+      sums.bb1 += gxx * px + gxy * py;
+      sums.bb2 += gxy * px + gyy * py;
+    }
+  }
+  return sums;
+}
+
+} // namespace
+
+void RefineCornersSubPix(const cv::Mat &gray, std::vector<cv::Point2f> &corners,
+                         const int half_win, const int max_iterations,
+                         const double epsilon) {
+  if (corners.empty() || half_win < 1) {
+    return;
+  }
+  CV_Assert(gray.type() == CV_8UC1 || gray.type() == CV_32FC1);
+  const int win = 2 * half_win + 1;
+
+  // gaussian weights of the window and x offsets to its center
+  cv::Mat mask(win, win, CV_32F);
+  std::vector<float> offsets_x(win);
+  for (int i = 0; i < win; ++i) {
+    const float y = static_cast<float>(i - half_win) / half_win;
+    for (int j = 0; j < win; ++j) {
+      const float x = static_cast<float>(j - half_win) / half_win;
+      mask.at<float>(i, j) = std::exp(-y * y) * std::exp(-x * x);
+    }
+  }
+  for (int j = 0; j < win; ++j) {
+    offsets_x[j] = static_cast<float>(j - half_win);
+  }
+
+  const double eps_sq = epsilon * epsilon;
+  const cv::Size patch_size(win + 2, win + 2);
+  cv::Mat patch;
+  for (auto &corner : corners) {
+    const cv::Point2f initial = corner;
+    cv::Point2f current = corner;
+    for (int iter = 0; iter < max_iterations; ++iter) {
+      cv::getRectSubPix(gray, patch_size, current, patch, CV_32F);
+      const GradientSums s =
+          AccumulateGradients(patch, mask, offsets_x, half_win);
+      const double det = static_cast<double>(s.a) * s.c -
+                         static_cast<double>(s.b) * s.b;
+      if (std::fabs(det) <= DBL_EPSILON * DBL_EPSILON) {
+        break;
+      }
+      const double scale = 1.0 / det;
+      const cv::Point2f next(
+          static_cast<float>(current.x + s.c * scale * s.bb1 -
+                             s.b * scale * s.bb2),
+          static_cast<float>(current.y - s.b * scale * s.bb1 +
+                             s.a * scale * s.bb2));
+      const double err = (next.x - current.x) * (next.x - current.x) +
+                         (next.y - current.y) * (next.y - current.y);
+      current = next;
+      if (current.x < 0 || current.x >= gray.cols || current.y < 0 ||
+          current.y >= gray.rows || err <= eps_sq) {
+        break;
+      }
+    }
+    if (std::fabs(current.x - initial.x) <= half_win &&
+        std::fabs(current.y - initial.y) <= half_win) {
+      corner = current;
+    }
+  }
+}
+
+} // namespace core
+} // namespace OpenICC
@@ -0,0 +1,94 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/io/binary_io.h"
+
+#include <string>
+
+namespace OpenICC {
+namespace io {
+
+void WriteBoardHeader(std::ofstream &file, const CornerStreamHeader &header) {
+  WritePod(file, static_cast<int32_t>(header.board_type));
+  WritePod(file, header.square_size_meter);
+  WritePod(file, header.camera_fps);
+  WritePod(file, static_cast<int32_t>(header.image_width));
+  WritePod(file, static_cast<int32_t>(header.image_height));
+  WritePod(file, static_cast<uint32_t>(header.scene_pt_ids.size()));
+  for (size_t i = 0; i < header.scene_pt_ids.size(); ++i) {
+    WritePod(file, static_cast<int32_t>(header.scene_pt_ids[i]));
+    WritePod(file, header.scene_pts[i][0]);
+    WritePod(file, header.scene_pts[i][1]);
+    WritePod(file, header.scene_pts[i][2]);
+  }
+}
+
+bool ReadBoardHeader(std::ifstream &file, CornerStreamHeader &header) {
+  int32_t board_type, width, height;
+  uint32_t nr_scene_pts;
+  if (!ReadPod(file, board_type) || !ReadPod(file, header.square_size_meter) ||
+      !ReadPod(file, header.camera_fps) || !ReadPod(file, width) ||
+      !ReadPod(file, height) || !ReadPod(file, nr_scene_pts)) {
+    return false;
+  }
+  header.board_type = board_type;
+  header.image_width = width;
+  header.image_height = height;
+  header.scene_pt_ids.resize(nr_scene_pts);
+  header.scene_pts.resize(nr_scene_pts);
+  for (uint32_t i = 0; i < nr_scene_pts; ++i) {
+    int32_t id;
+    if (!ReadPod(file, id) || !ReadPod(file, header.scene_pts[i][0]) ||
+        !ReadPod(file, header.scene_pts[i][1]) ||
+        !ReadPod(file, header.scene_pts[i][2])) {
+      return false;
+    }
+    header.scene_pt_ids[i] = id;
+  }
+  return true;
+}
+
+void BoardHeaderToJson(const CornerStreamHeader &header,
+                       nlohmann::json &scene_json) {
+  scene_json["camera_fps"] = header.camera_fps;
+  scene_json["calibration_board_type"] = header.board_type;
+  scene_json["square_size_meter"] = header.square_size_meter;
+  scene_json["image_width"] = header.image_width;
+  scene_json["image_height"] = header.image_height;
+  for (size_t i = 0; i < header.scene_pt_ids.size(); ++i) {
+    scene_json["scene_pts"][std::to_string(header.scene_pt_ids[i])] = {
+        header.scene_pts[i][0], header.scene_pts[i][1],
+        header.scene_pts[i][2]};
+  }
+}
+
+CornerStreamHeader BoardHeaderFromJson(const nlohmann::json &scene_json) {
+  CornerStreamHeader header;
+  header.camera_fps = scene_json.value("camera_fps", 0.0);
+  header.board_type = scene_json.value("calibration_board_type", 0);
+  header.square_size_meter = scene_json.value("square_size_meter", 0.0);
+  header.image_width = scene_json.value("image_width", 0);
+  header.image_height = scene_json.value("image_height", 0);
+  if (scene_json.contains("scene_pts")) {
+    for (const auto &pt : scene_json["scene_pts"].items()) {
+      header.scene_pt_ids.push_back(std::stoi(pt.key()));
+      header.scene_pts.push_back(
+          Eigen::Vector3d(pt.value()[0], pt.value()[1], pt.value()[2]));
+    }
+  }
+  return header;
+}
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,425 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/io/corner_archive.h"
+#include "OpenCameraCalibrator/io/binary_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+const char kArchiveMagic[4] = {'O', 'I', 'C', 'Z'};
+const char kBlockMagic[4] = {'B', 'L', 'C', 'K'};
+
+//! Corner coordinates are stored in 1/kFixedPointScale px
+const double kFixedPointScale = 256.0;
+
+const uint8_t kIdGaps = 0;
+const uint8_t kIdBitmap = 1;
+
+//! Upper limit of a block, protects against reading garbage sizes
+const uint32_t kMaxBlockBytes = 1u << 30;
+
+template <typename T> void PutRaw(std::vector<uint8_t> &buffer, const T &value) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void PutVarint(std::vector<uint8_t> &buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ZigZag(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+size_t VarintSize(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+//! Bounds checked decoding of a block payload
+class BlockDecoder {
+public:
+  BlockDecoder(const std::vector<uint8_t> &buffer, size_t &pos)
+      : data_(buffer.data()), size_(buffer.size()), pos_(pos) {}
+
+  bool Varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos_ >= size_) {
+        return false;
+      }
+      const uint8_t byte = data_[pos_++];
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool SignedVarint(int64_t &value) {
+    uint64_t zigzag;
+    if (!Varint(zigzag)) {
+      return false;
+    }
+    value = UnZigZag(zigzag);
+    return true;
+  }
+
+  template <typename T> bool Raw(T &value) {
+    if (pos_ + sizeof(T) > size_) {
+      return false;
+    }
+    std::memcpy(&value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  const uint8_t *Bytes(const size_t nr_bytes) {
+    if (pos_ + nr_bytes > size_) {
+      return nullptr;
+    }
+    const uint8_t *bytes = data_ + pos_;
+    pos_ += nr_bytes;
+    return bytes;
+  }
+
+private:
+  const uint8_t *data_;
+  size_t size_;
+  size_t &pos_;
+};
+
+} // namespace
+
+bool IsCornerArchivePath(const std::string &path) {
+  return path.size() >= kCornerArchiveExtension.size() &&
+         path.compare(path.size() - kCornerArchiveExtension.size(),
+                      kCornerArchiveExtension.size(),
+                      kCornerArchiveExtension) == 0;
+}
+
+bool CornerArchiveWriter::Open(const std::string &path,
+                               const CornerStreamHeader &header,
+                               const bool lossless,
+                               const uint32_t views_per_block) {
+  file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  lossless_ = lossless;
+  views_per_block_ = std::max(1u, views_per_block);
+  block_.clear();
+  block_views_ = 0;
+  last_timestamp_ns_ = 0;
+
+  file_.write(kArchiveMagic, 4);
+  WritePod(file_, kCornerArchiveVersion);
+  WritePod(file_, static_cast<uint8_t>(lossless_));
+  WritePod(file_, views_per_block_);
+  WriteBoardHeader(file_, header);
+  return file_.good();
+}
+
+bool CornerArchiveWriter::WriteView(
+    const double timestamp_us, const std::vector<int> &ids,
+    const aligned_vector<Eigen::Vector2d> &corners,
+    const ViewQuality &quality) {
+  // every block starts with an absolute timestamp
+  const int64_t timestamp_ns = std::llround(timestamp_us * 1e3);
+  PutVarint(block_, ZigZag(timestamp_ns - last_timestamp_ns_));
+  last_timestamp_ns_ = timestamp_ns;
+
+  std::vector<size_t> order(ids.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&ids](const size_t a, const size_t b) { return ids[a] < ids[b]; });
+  PutVarint(block_, ids.size());
+  if (!ids.empty()) {
+    const int first_id = ids[order.front()];
+    const uint64_t span = ids[order.back()] - first_id + 1;
+    size_t gap_bytes = 0;
+    bool unique = true;
+    for (size_t i = 1; i < order.size(); ++i) {
+      const int gap = ids[order[i]] - ids[order[i - 1]];
+      gap_bytes += VarintSize(gap);
+      unique &= gap > 0;
+    }
+    PutVarint(block_, ZigZag(first_id));
+    if (unique && VarintSize(span) + (span + 7) / 8 < gap_bytes) {
+      block_.push_back(kIdBitmap);
+      PutVarint(block_, span);
+      const size_t bitmap_start = block_.size();
+      block_.resize(bitmap_start + (span + 7) / 8, 0);
+      for (const size_t i : order) {
+        const uint64_t bit = ids[i] - first_id;
+        block_[bitmap_start + bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+      }
+    } else {
+      block_.push_back(kIdGaps);
+      for (size_t i = 1; i < order.size(); ++i) {
+        PutVarint(block_, ids[order[i]] - ids[order[i - 1]]);
+      }
+    }
+  }
+  // neighboring board ids are close in the image, so the deltas are small
+  int64_t last_x = 0, last_y = 0;
+  for (const size_t i : order) {
+    if (lossless_) {
+      PutRaw(block_, corners[i][0]);
+      PutRaw(block_, corners[i][1]);
+    } else {
+      const int64_t x = std::llround(corners[i][0] * kFixedPointScale);
+      const int64_t y = std::llround(corners[i][1] * kFixedPointScale);
+      PutVarint(block_, ZigZag(x - last_x));
+      PutVarint(block_, ZigZag(y - last_y));
+      last_x = x;
+      last_y = y;
+    }
+  }
+  PutRaw(block_, quality.sharpness);
+  PutRaw(block_, quality.saturated_fraction);
+
+  if (++block_views_ >= views_per_block_) {
+    return FlushBlock();
+  }
+  return true;
+}
+
+bool CornerArchiveWriter::FlushBlock() {
+  if (block_views_ > 0) {
+    file_.write(kBlockMagic, 4);
+    WritePod(file_, block_views_);
+    WritePod(file_, static_cast<uint32_t>(block_.size()));
+    file_.write(reinterpret_cast<const char *>(block_.data()), block_.size());
+  }
+  block_.clear();
+  block_views_ = 0;
+  last_timestamp_ns_ = 0;
+  return file_.good();
+}
+
+bool CornerArchiveWriter::Close() {
+  if (!file_.is_open()) {
+    return true;
+  }
+  const bool success = FlushBlock();
+  file_.close();
+  return success;
+}
+
+bool CornerArchiveReader::Open(const std::string &path) {
+  file_.open(path, std::ios::in | std::ios::binary);
+  if (!file_.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  char magic[4];
+  uint32_t version;
+  uint8_t lossless;
+  uint32_t views_per_block;
+  if (!file_.read(magic, 4) || std::memcmp(magic, kArchiveMagic, 4) != 0 ||
+      !ReadPod(file_, version) || version != kCornerArchiveVersion ||
+      !ReadPod(file_, lossless) || !ReadPod(file_, views_per_block)) {
+    std::cerr << path << " is not a corner archive file.\n";
+    return false;
+  }
+  lossless_ = lossless != 0;
+  if (!ReadBoardHeader(file_, header_)) {
+    return false;
+  }
+  block_views_left_ = 0;
+  return true;
+}
+
+bool CornerArchiveReader::ReadBlock() {
+  char magic[4];
+  uint32_t payload_bytes;
+  if (!file_.read(magic, 4) || std::memcmp(magic, kBlockMagic, 4) != 0 ||
+      !ReadPod(file_, block_views_left_) || !ReadPod(file_, payload_bytes) ||
+      payload_bytes > kMaxBlockBytes) {
+    block_views_left_ = 0;
+    return false;
+  }
+  block_.resize(payload_bytes);
+  if (!file_.read(reinterpret_cast<char *>(block_.data()), payload_bytes)) {
+    block_views_left_ = 0;
+    return false;
+  }
+  block_pos_ = 0;
+  last_timestamp_ns_ = 0;
+  return true;
+}
+
+bool CornerArchiveReader::ReadNextView(
+    double &timestamp_us, std::vector<int> &ids,
+    aligned_vector<Eigen::Vector2d> &corners, ViewQuality &quality) {
+  while (block_views_left_ == 0) {
+    if (!ReadBlock()) {
+      return false;
+    }
+  }
+  --block_views_left_;
+  BlockDecoder decoder(block_, block_pos_);
+  int64_t delta_ns;
+  uint64_t nr_corners;
+  if (!decoder.SignedVarint(delta_ns) || !decoder.Varint(nr_corners) ||
+      nr_corners > block_.size()) {
+    return false;
+  }
+  last_timestamp_ns_ += delta_ns;
+  timestamp_us = last_timestamp_ns_ * 1e-3;
+
+  ids.resize(nr_corners);
+  corners.resize(nr_corners);
+  if (nr_corners > 0) {
+    int64_t first_id;
+    uint8_t coding;
+    if (!decoder.SignedVarint(first_id) || !decoder.Raw(coding)) {
+      return false;
+    }
+    if (coding == kIdBitmap) {
+      uint64_t span;
+      const uint8_t *bitmap = nullptr;
+      if (!decoder.Varint(span) ||
+          !(bitmap = decoder.Bytes((span + 7) / 8))) {
+        return false;
+      }
+      size_t c = 0;
+      for (uint64_t bit = 0; bit < span && c < nr_corners; ++bit) {
+        if (bitmap[bit / 8] & (1u << (bit % 8))) {
+          ids[c++] = static_cast<int>(first_id + bit);
+        }
+      }
+      if (c != nr_corners) {
+        return false;
+      }
+    } else {
+      ids[0] = static_cast<int>(first_id);
+      for (size_t c = 1; c < nr_corners; ++c) {
+        uint64_t gap;
+        if (!decoder.Varint(gap)) {
+          return false;
+        }
+        ids[c] = ids[c - 1] + static_cast<int>(gap);
+      }
+    }
+  }
+  int64_t x = 0, y = 0;
+  for (size_t c = 0; c < nr_corners; ++c) {
+    if (lossless_) {
+      if (!decoder.Raw(corners[c][0]) || !decoder.Raw(corners[c][1])) {
+        return false;
+      }
+    } else {
+      int64_t dx, dy;
+      if (!decoder.SignedVarint(dx) || !decoder.SignedVarint(dy)) {
+        return false;
+      }
+      x += dx;
+      y += dy;
+      corners[c] = Eigen::Vector2d(x / kFixedPointScale, y / kFixedPointScale);
+    }
+  }
+  return decoder.Raw(quality.sharpness) &&
+         decoder.Raw(quality.saturated_fraction);
+}
+
+bool read_scene_corner_archive(const std::string &input_path,
+                               nlohmann::json &scene_json) {
+  CornerArchiveReader reader;
+  if (!reader.Open(input_path)) {
+    return false;
+  }
+  BoardHeaderToJson(reader.Header(), scene_json);
+
+  double timestamp_us;
+  std::vector<int> ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  ViewQuality quality;
+  while (reader.ReadNextView(timestamp_us, ids, corners, quality)) {
+    auto &view = scene_json["views"][std::to_string(timestamp_us)];
+    auto &image_points = view["image_points"];
+    for (size_t c = 0; c < ids.size(); ++c) {
+      image_points[std::to_string(ids[c])] = {corners[c][0], corners[c][1]};
+    }
+    view["sharpness"] = quality.sharpness;
+    view["saturated_fraction"] = quality.saturated_fraction;
+  }
+  return true;
+}
+
+bool write_scene_corner_archive(const nlohmann::json &scene_json,
+                                const std::string &output_path,
+                                const bool lossless) {
+  const CornerStreamHeader header = BoardHeaderFromJson(scene_json);
+
+  CornerArchiveWriter writer;
+  if (!writer.Open(output_path, header, lossless)) {
+    return false;
+  }
+  if (scene_json.contains("views")) {
+    // the deltas are small if the views are ordered by time
+    std::vector<std::pair<double, std::string>> views;
+    for (const auto &view : scene_json["views"].items()) {
+      views.push_back(std::make_pair(std::stod(view.key()), view.key()));
+    }
+    std::sort(views.begin(), views.end());
+    std::vector<int> ids;
+    aligned_vector<Eigen::Vector2d> corners;
+    for (const auto &view : views) {
+      const auto &view_json = scene_json["views"][view.second];
+      ids.clear();
+      corners.clear();
+      for (const auto &img_pts : view_json["image_points"].items()) {
+        ids.push_back(std::stoi(img_pts.key()));
+        corners.push_back(
+            Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
+      }
+      ViewQuality quality;
+      quality.sharpness = view_json.value("sharpness", 0.f);
+      quality.saturated_fraction = view_json.value("saturated_fraction", 0.f);
+      if (!writer.WriteView(view.first, ids, corners, quality)) {
+        return false;
+      }
+    }
+  }
+  return writer.Close();
+}
+
+} // namespace io
+} // namespace OpenICC
@@ -0,0 +1,233 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/io/corner_dataset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "OpenCameraCalibrator/io/binary_io.h"
+#include "OpenCameraCalibrator/io/corner_archive.h"
+#include "OpenCameraCalibrator/io/read_scene.h"
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+//! Corner files store the view timestamps in microseconds
+int64_t MicrosecondsToNs(const double timestamp_us) {
+  return static_cast<int64_t>(std::llround(timestamp_us * 1e3));
+}
+
+} // namespace
+
+bool CornerDataset::Load(const std::string &path) {
+  return Load(path, ViewSelection());
+}
+
+bool CornerDataset::Load(const std::string &path,
+                         const ViewSelection &selection) {
+  std::ifstream input_file(path, std::ios::binary);
+  if (!input_file.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  char magic[4] = {0, 0, 0, 0};
+  input_file.read(magic, 4);
+  input_file.close();
+  if (std::string(magic, 4) == "OICC") {
+    return FromCornerStream(path, selection);
+  }
+  if (std::string(magic, 4) == "OICZ") {
+    return FromCornerArchive(path, selection);
+  }
+  nlohmann::json scene_json;
+  if (!read_scene(path, selection, scene_json)) {
+    return false;
+  }
+  return FromJson(scene_json);
+}
+
+bool CornerDataset::FromJson(const nlohmann::json &scene_json) {
+  Clear();
+  header_ = BoardHeaderFromJson(scene_json);
+  if (!scene_json.contains("views")) {
+    return true;
+  }
+
+  std::vector<int> ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  for (const auto &view : scene_json["views"].items()) {
+    ids.clear();
+    corners.clear();
+    const auto &view_json = view.value();
+    for (const auto &img_pts : view_json["image_points"].items()) {
+      ids.push_back(std::stoi(img_pts.key()));
+      corners.push_back(
+          Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
+    }
+    ViewQuality quality;
+    quality.sharpness = view_json.value("sharpness", 0.f);
+    quality.saturated_fraction = view_json.value("saturated_fraction", 0.f);
+    AddView(MicrosecondsToNs(std::stod(view.key())), ids, corners, quality);
+  }
+  // the json views are ordered by their key string, not by time
+  SortViews();
+  return true;
+}
+
+bool CornerDataset::FromCornerStream(const std::string &path,
+                                     const ViewSelection &selection) {
+  Clear();
+  CornerStreamReader reader;
+  if (!reader.Open(path)) {
+    return false;
+  }
+  header_ = reader.Header();
+
+  double timestamp_us;
+  std::vector<int> ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  ViewQuality quality;
+  if (selection.SelectsAll()) {
+    while (reader.ReadNextView(timestamp_us, ids, corners, quality)) {
+      AddView(MicrosecondsToNs(timestamp_us), ids, corners, quality);
+    }
+  } else {
+    for (const size_t view : reader.SelectViews(selection)) {
+      if (!reader.ReadView(view, timestamp_us, ids, corners, quality)) {
+        break;
+      }
+      AddView(MicrosecondsToNs(timestamp_us), ids, corners, quality);
+    }
+  }
+  SortViews();
+  return true;
+}
+
+bool CornerDataset::FromCornerArchive(const std::string &path,
+                                      const ViewSelection &selection) {
+  Clear();
+  CornerArchiveReader reader;
+  if (!reader.Open(path)) {
+    return false;
+  }
+  header_ = reader.Header();
+
+  double timestamp_us;
+  std::vector<int> ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  ViewQuality quality;
+  // archives have no view index, the views are selected while decoding
+  while (reader.ReadNextView(timestamp_us, ids, corners, quality)) {
+    const double timestamp_s = timestamp_us * US_TO_S;
+    if (timestamp_s >= selection.start_s && timestamp_s <= selection.end_s) {
+      AddView(MicrosecondsToNs(timestamp_us), ids, corners, quality);
+    }
+  }
+  SortViews();
+  KeepEveryKthView(selection.every_kth_view);
+  return true;
+}
+
+void CornerDataset::KeepEveryKthView(const int k) {
+  if (k <= 1) {
+    return;
+  }
+  size_t nr_kept = 0;
+  size_t nr_corners = 0;
+  for (size_t v = 0; v < timestamps_ns_.size(); v += k, ++nr_kept) {
+    const size_t begin = offsets_[v], end = offsets_[v + 1];
+    timestamps_ns_[nr_kept] = timestamps_ns_[v];
+    qualities_[nr_kept] = qualities_[v];
+    std::copy(point_ids_.begin() + begin, point_ids_.begin() + end,
+              point_ids_.begin() + nr_corners);
+    std::copy(xy_.begin() + 2 * begin, xy_.begin() + 2 * end,
+              xy_.begin() + 2 * nr_corners);
+    nr_corners += end - begin;
+    offsets_[nr_kept + 1] = nr_corners;
+  }
+  timestamps_ns_.resize(nr_kept);
+  qualities_.resize(nr_kept);
+  offsets_.resize(nr_kept + 1);
+  point_ids_.resize(nr_corners);
+  xy_.resize(2 * nr_corners);
+}
+
+void CornerDataset::Clear() {
+  header_ = CornerStreamHeader();
+  timestamps_ns_.clear();
+  offsets_.assign(1, 0);
+  qualities_.clear();
+  point_ids_.clear();
+  xy_.clear();
+}
+
+void CornerDataset::AddView(const int64_t timestamp_ns,
+                            const std::vector<int> &ids,
+                            const aligned_vector<Eigen::Vector2d> &corners,
+                            const ViewQuality &quality) {
+  timestamps_ns_.push_back(timestamp_ns);
+  qualities_.push_back(quality);
+  point_ids_.insert(point_ids_.end(), ids.begin(), ids.end());
+  for (const auto &corner : corners) {
+    xy_.push_back(corner[0]);
+    xy_.push_back(corner[1]);
+  }
+  offsets_.push_back(point_ids_.size());
+}
+
+void CornerDataset::SortViews() {
+  if (std::is_sorted(timestamps_ns_.begin(), timestamps_ns_.end())) {
+    return;
+  }
+  std::vector<size_t> order(timestamps_ns_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [this](const size_t a, const size_t b) {
+                     return timestamps_ns_[a] < timestamps_ns_[b];
+                   });
+
+  std::vector<int64_t> timestamps_ns;
+  std::vector<size_t> offsets{0};
+  std::vector<ViewQuality> qualities;
+  std::vector<int> point_ids;
+  std::vector<double> xy;
+  timestamps_ns.reserve(timestamps_ns_.size());
+  offsets.reserve(offsets_.size());
+  qualities.reserve(qualities_.size());
+  point_ids.reserve(point_ids_.size());
+  xy.reserve(xy_.size());
+  for (const size_t v : order) {
+    timestamps_ns.push_back(timestamps_ns_[v]);
+    qualities.push_back(qualities_[v]);
+    point_ids.insert(point_ids.end(), point_ids_.begin() + offsets_[v],
+                     point_ids_.begin() + offsets_[v + 1]);
+    xy.insert(xy.end(), xy_.begin() + 2 * offsets_[v],
+              xy_.begin() + 2 * offsets_[v + 1]);
+    offsets.push_back(point_ids.size());
+  }
+  timestamps_ns_.swap(timestamps_ns);
+  offsets_.swap(offsets);
+  qualities_.swap(qualities);
+  point_ids_.swap(point_ids);
+  xy_.swap(xy);
+}
+
+} // namespace io
+} // namespace OpenICC
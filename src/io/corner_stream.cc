@@ -0,0 +1,422 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/io/binary_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+const char kHeaderMagic[4] = {'O', 'I', 'C', 'C'};
+const char kViewMagic[4] = {'V', 'I', 'E', 'W'};
+const char kIndexMagic[4] = {'V', 'I', 'D', 'X'};
+const char kIndexEndMagic[4] = {'O', 'I', 'D', 'X'};
+
+//! u64 offset of the index and its end magic
+const uint64_t kIndexTrailerBytes = sizeof(uint64_t) + 4;
+
+bool TimestampLess(const CornerStreamIndexEntry &a,
+                   const CornerStreamIndexEntry &b) {
+  return a.timestamp_us < b.timestamp_us;
+}
+
+} // namespace
+
+bool IsCornerStreamPath(const std::string &path) {
+  return path.size() >= kCornerStreamExtension.size() &&
+         path.compare(path.size() - kCornerStreamExtension.size(),
+                      kCornerStreamExtension.size(),
+                      kCornerStreamExtension) == 0;
+}
+
+bool CornerStreamWriter::Open(const std::string &path,
+                              const CornerStreamHeader &header) {
+  file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  file_.write(kHeaderMagic, 4);
+  WritePod(file_, kCornerStreamVersion);
+  WriteBoardHeader(file_, header);
+  file_.flush();
+  path_ = path;
+  bytes_written_ = static_cast<uint64_t>(file_.tellp());
+  index_.clear();
+  return file_.good();
+}
+
+bool CornerStreamWriter::Resume(const std::string &path,
+                                const uint64_t valid_bytes) {
+  {
+    // records of different versions can not be mixed
+    std::ifstream existing(path, std::ios::in | std::ios::binary);
+    char magic[4];
+    uint32_t version = 0;
+    if (!existing.read(magic, 4) || std::memcmp(magic, kHeaderMagic, 4) != 0 ||
+        !ReadPod(existing, version) || version != kCornerStreamVersion) {
+      std::cerr << "Can not resume " << path
+                << ", it is no corner stream of version "
+                << kCornerStreamVersion << "\n";
+      return false;
+    }
+  }
+  // truncate would pad a shorter file with zeros, i.e. invalid records
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0 ||
+      static_cast<uint64_t>(file_stat.st_size) < valid_bytes) {
+    std::cerr << "Can not resume " << path << ", it is shorter than its "
+              << "checkpoint (" << valid_bytes << " bytes)\n";
+    return false;
+  }
+  if (truncate(path.c_str(), static_cast<off_t>(valid_bytes)) != 0) {
+    std::cerr << "Can not truncate " << path << "\n";
+    return false;
+  }
+  // the index of the views before the checkpoint is written again on Close
+  {
+    CornerStreamReader reader;
+    if (!reader.Open(path)) {
+      return false;
+    }
+    index_ = reader.Index();
+  }
+  file_.open(path, std::ios::out | std::ios::binary | std::ios::app);
+  if (!file_.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  path_ = path;
+  bytes_written_ = valid_bytes;
+  return true;
+}
+
+bool CornerStreamWriter::WriteView(
+    const double timestamp_us, const std::vector<int> &ids,
+    const aligned_vector<Eigen::Vector2d> &corners,
+    const ViewQuality &quality) {
+  CornerStreamIndexEntry entry;
+  entry.timestamp_us = timestamp_us;
+  entry.offset = bytes_written_;
+  index_.push_back(entry);
+  file_.write(kViewMagic, 4);
+  WritePod(file_, timestamp_us);
+  WritePod(file_, quality.sharpness);
+  WritePod(file_, quality.saturated_fraction);
+  WritePod(file_, static_cast<uint32_t>(ids.size()));
+  for (size_t i = 0; i < ids.size(); ++i) {
+    WritePod(file_, static_cast<int32_t>(ids[i]));
+    WritePod(file_, corners[i][0]);
+    WritePod(file_, corners[i][1]);
+  }
+  bytes_written_ += 4 + sizeof(double) + 2 * sizeof(float) +
+                    sizeof(uint32_t) +
+                    ids.size() * (sizeof(int32_t) + 2 * sizeof(double));
+  // a crash should only lose the views that are currently in flight
+  file_.flush();
+  return file_.good();
+}
+
+bool CornerStreamWriter::Sync() {
+  file_.flush();
+  if (!file_.good()) {
+    return false;
+  }
+  // std::ofstream does not expose its descriptor, fsync syncs the file
+  // through any descriptor
+  const int fd = open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+bool CornerStreamWriter::Close() {
+  if (!file_.is_open()) {
+    return true;
+  }
+  std::stable_sort(index_.begin(), index_.end(), TimestampLess);
+  file_.write(kIndexMagic, 4);
+  WritePod(file_, static_cast<uint32_t>(index_.size()));
+  for (const auto &entry : index_) {
+    WritePod(file_, entry.timestamp_us);
+    WritePod(file_, entry.offset);
+  }
+  WritePod(file_, bytes_written_);
+  file_.write(kIndexEndMagic, 4);
+  file_.flush();
+  const bool success = file_.good();
+  file_.close();
+  index_.clear();
+  return success && !file_.fail();
+}
+
+bool CornerStreamReader::Open(const std::string &path) {
+  file_.open(path, std::ios::in | std::ios::binary);
+  if (!file_.is_open()) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  char magic[4];
+  if (!file_.read(magic, 4) || std::memcmp(magic, kHeaderMagic, 4) != 0 ||
+      !ReadPod(file_, version_) || version_ < 1 ||
+      version_ > kCornerStreamVersion) {
+    std::cerr << path << " is not a corner stream file.\n";
+    return false;
+  }
+  if (!ReadBoardHeader(file_, header_)) {
+    return false;
+  }
+  data_start_ = static_cast<uint64_t>(file_.tellg());
+  return true;
+}
+
+const std::vector<CornerStreamIndexEntry> &CornerStreamReader::Index() {
+  if (!index_loaded_) {
+    const std::streampos position = file_.tellg();
+    if (!ReadIndexFooter()) {
+      ScanIndex();
+    }
+    std::stable_sort(index_.begin(), index_.end(), TimestampLess);
+    index_loaded_ = true;
+    file_.clear();
+    file_.seekg(position);
+  }
+  return index_;
+}
+
+bool CornerStreamReader::ReadIndexFooter() {
+  index_.clear();
+  file_.clear();
+  file_.seekg(0, std::ios::end);
+  const uint64_t file_size = static_cast<uint64_t>(file_.tellg());
+  if (file_size < data_start_ + kIndexTrailerBytes) {
+    return false;
+  }
+  uint64_t index_offset;
+  char magic[4];
+  file_.seekg(file_size - kIndexTrailerBytes);
+  if (!ReadPod(file_, index_offset) || !file_.read(magic, 4) ||
+      std::memcmp(magic, kIndexEndMagic, 4) != 0 ||
+      index_offset < data_start_ || index_offset >= file_size) {
+    return false;
+  }
+  uint32_t nr_views;
+  file_.seekg(index_offset);
+  if (!file_.read(magic, 4) || std::memcmp(magic, kIndexMagic, 4) != 0 ||
+      !ReadPod(file_, nr_views) ||
+      index_offset + 8 + nr_views * 16ull + kIndexTrailerBytes != file_size) {
+    return false;
+  }
+  index_.resize(nr_views);
+  for (auto &entry : index_) {
+    if (!ReadPod(file_, entry.timestamp_us) || !ReadPod(file_, entry.offset)) {
+      index_.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void CornerStreamReader::ScanIndex() {
+  index_.clear();
+  file_.clear();
+  file_.seekg(0, std::ios::end);
+  const uint64_t file_size = static_cast<uint64_t>(file_.tellg());
+  const uint64_t corner_bytes = sizeof(int32_t) + 2 * sizeof(double);
+  uint64_t offset = data_start_;
+  file_.seekg(offset);
+  char magic[4];
+  CornerStreamIndexEntry entry;
+  ViewQuality quality;
+  uint32_t nr_corners;
+  // only the record headers are read, the corners are skipped
+  while (file_.read(magic, 4) && std::memcmp(magic, kViewMagic, 4) == 0 &&
+         ReadPod(file_, entry.timestamp_us)) {
+    if (version_ >= 2 && (!ReadPod(file_, quality.sharpness) ||
+                          !ReadPod(file_, quality.saturated_fraction))) {
+      break;
+    }
+    if (!ReadPod(file_, nr_corners)) {
+      break;
+    }
+    const uint64_t record_end =
+        static_cast<uint64_t>(file_.tellg()) + nr_corners * corner_bytes;
+    // a partially written record is ignored
+    if (record_end > file_size) {
+      break;
+    }
+    entry.offset = offset;
+    index_.push_back(entry);
+    offset = record_end;
+    file_.seekg(offset);
+  }
+}
+
+std::vector<size_t>
+CornerStreamReader::SelectViews(const ViewSelection &selection) {
+  const std::vector<CornerStreamIndexEntry> &index = Index();
+  CornerStreamIndexEntry start, end;
+  start.timestamp_us = selection.start_s * S_TO_US;
+  end.timestamp_us = selection.end_s * S_TO_US;
+  const size_t first =
+      std::lower_bound(index.begin(), index.end(), start, TimestampLess) -
+      index.begin();
+  const size_t last =
+      std::upper_bound(index.begin(), index.end(), end, TimestampLess) -
+      index.begin();
+  const size_t stride = std::max(1, selection.every_kth_view);
+  std::vector<size_t> selected;
+  for (size_t i = first; i < last; i += stride) {
+    selected.push_back(i);
+  }
+  return selected;
+}
+
+bool CornerStreamReader::ReadView(const size_t index_pos,
+                                  double &timestamp_us, std::vector<int> &ids,
+                                  aligned_vector<Eigen::Vector2d> &corners,
+                                  ViewQuality &quality) {
+  const std::vector<CornerStreamIndexEntry> &index = Index();
+  if (index_pos >= index.size()) {
+    return false;
+  }
+  file_.clear();
+  file_.seekg(index[index_pos].offset);
+  return ReadNextView(timestamp_us, ids, corners, quality);
+}
+
+bool CornerStreamReader::ReadNextView(
+    double &timestamp_us, std::vector<int> &ids,
+    aligned_vector<Eigen::Vector2d> &corners) {
+  ViewQuality quality;
+  return ReadNextView(timestamp_us, ids, corners, quality);
+}
+
+bool CornerStreamReader::ReadNextView(
+    double &timestamp_us, std::vector<int> &ids,
+    aligned_vector<Eigen::Vector2d> &corners, ViewQuality &quality) {
+  char magic[4];
+  uint32_t nr_corners;
+  if (!file_.read(magic, 4) || std::memcmp(magic, kViewMagic, 4) != 0 ||
+      !ReadPod(file_, timestamp_us)) {
+    return false;
+  }
+  quality = ViewQuality();
+  if (version_ >= 2 && (!ReadPod(file_, quality.sharpness) ||
+                        !ReadPod(file_, quality.saturated_fraction))) {
+    return false;
+  }
+  if (!ReadPod(file_, nr_corners)) {
+    return false;
+  }
+  ids.resize(nr_corners);
+  corners.resize(nr_corners);
+  for (uint32_t i = 0; i < nr_corners; ++i) {
+    int32_t id;
+    if (!ReadPod(file_, id) || !ReadPod(file_, corners[i][0]) ||
+        !ReadPod(file_, corners[i][1])) {
+      return false;
+    }
+    ids[i] = id;
+  }
+  return true;
+}
+
+bool read_scene_corner_stream(const std::string &input_path,
+                              nlohmann::json &scene_json) {
+  return read_scene_corner_stream(input_path, ViewSelection(), scene_json);
+}
+
+bool read_scene_corner_stream(const std::string &input_path,
+                              const ViewSelection &selection,
+                              nlohmann::json &scene_json) {
+  CornerStreamReader reader;
+  if (!reader.Open(input_path)) {
+    return false;
+  }
+  BoardHeaderToJson(reader.Header(), scene_json);
+
+  double timestamp_us;
+  std::vector<int> ids;
+  aligned_vector<Eigen::Vector2d> corners;
+  ViewQuality quality;
+  // the whole file is read sequentially, a part with the view index
+  const bool read_all = selection.SelectsAll();
+  const std::vector<size_t> selected =
+      read_all ? std::vector<size_t>() : reader.SelectViews(selection);
+  for (size_t s = 0; read_all || s < selected.size(); ++s) {
+    if (read_all
+            ? !reader.ReadNextView(timestamp_us, ids, corners, quality)
+            : !reader.ReadView(selected[s], timestamp_us, ids, corners,
+                               quality)) {
+      break;
+    }
+    auto &view = scene_json["views"][std::to_string(timestamp_us)];
+    auto &image_points = view["image_points"];
+    for (size_t c = 0; c < ids.size(); ++c) {
+      image_points[std::to_string(ids[c])] = {corners[c][0], corners[c][1]};
+    }
+    if (reader.Version() >= 2) {
+      view["sharpness"] = quality.sharpness;
+      view["saturated_fraction"] = quality.saturated_fraction;
+    }
+  }
+  return true;
+}
+
+bool write_scene_corner_stream(const nlohmann::json &scene_json,
+                               const std::string &output_path) {
+  const CornerStreamHeader header = BoardHeaderFromJson(scene_json);
+
+  CornerStreamWriter writer;
+  if (!writer.Open(output_path, header)) {
+    return false;
+  }
+  if (scene_json.contains("views")) {
+    for (const auto &view : scene_json["views"].items()) {
+      std::vector<int> ids;
+      aligned_vector<Eigen::Vector2d> corners;
+      for (const auto &img_pts : view.value()["image_points"].items()) {
+        ids.push_back(std::stoi(img_pts.key()));
+        corners.push_back(
+            Eigen::Vector2d(img_pts.value()[0], img_pts.value()[1]));
+      }
+      ViewQuality quality;
+      if (view.value().contains("sharpness")) {
+        quality.sharpness = view.value()["sharpness"];
+        quality.saturated_fraction = view.value()["saturated_fraction"];
+      }
+      if (!writer.WriteView(std::stod(view.key()), ids, corners, quality)) {
+        return false;
+      }
+    }
+  }
+  return writer.Close();
+}
+
+} // namespace io
+} // namespace OpenICC
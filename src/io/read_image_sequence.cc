@@ -0,0 +1,138 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/io/read_image_sequence.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+std::string FileName(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string FileStem(const std::string &path) {
+  const std::string name = FileName(path);
+  return name.substr(0, name.find_last_of('.'));
+}
+
+} // namespace
+
+bool ReadImageTimestamps(const std::string &path_to_timestamps,
+                         std::map<std::string, double> &timestamps_s) {
+  std::ifstream file(path_to_timestamps);
+  if (!file.is_open()) {
+    std::cerr << "Could not open " << path_to_timestamps << "\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::stringstream line_stream(line);
+    std::string name;
+    double timestamp_s;
+    if (!(line_stream >> name >> timestamp_s)) {
+      std::cerr << "Invalid line in " << path_to_timestamps << ": " << line
+                << "\n";
+      return false;
+    }
+    timestamps_s[FileName(name)] = timestamp_s;
+  }
+  return true;
+}
+
+bool GetImageSequenceTimestamps(std::vector<std::string> &image_paths,
+                                const std::string &path_to_timestamps,
+                                const double file_name_to_s, const double fps,
+                                std::vector<double> &timestamps_s) {
+  timestamps_s.clear();
+  if (!path_to_timestamps.empty()) {
+    std::map<std::string, double> timestamps_of_names;
+    if (!ReadImageTimestamps(path_to_timestamps, timestamps_of_names)) {
+      return false;
+    }
+    for (const auto &image_path : image_paths) {
+      const auto it = timestamps_of_names.find(FileName(image_path));
+      if (it == timestamps_of_names.end()) {
+        std::cerr << "No timestamp for " << image_path << " in "
+                  << path_to_timestamps << "\n";
+        return false;
+      }
+      timestamps_s.push_back(it->second);
+    }
+  } else {
+    // numeric file names
+    for (const auto &image_path : image_paths) {
+      const std::string stem = FileStem(image_path);
+      char *end = nullptr;
+      const double value = std::strtod(stem.c_str(), &end);
+      if (stem.empty() || *end != '\0') {
+        timestamps_s.clear();
+        break;
+      }
+      timestamps_s.push_back(value * file_name_to_s);
+    }
+  }
+  if (timestamps_s.empty()) {
+    if (fps <= 0.0) {
+      std::cerr << "Image file names are no timestamps and no frame rate was "
+                   "given.\n";
+      return false;
+    }
+    for (size_t i = 0; i < image_paths.size(); ++i) {
+      timestamps_s.push_back(i / fps);
+    }
+    return true;
+  }
+
+  // frame indices follow the timestamps, not the file name order
+  std::vector<size_t> order(image_paths.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return timestamps_s[a] < timestamps_s[b];
+  });
+  std::vector<std::string> sorted_paths;
+  std::vector<double> sorted_timestamps_s;
+  for (const size_t i : order) {
+    if (!sorted_timestamps_s.empty() &&
+        timestamps_s[i] <= sorted_timestamps_s.back()) {
+      std::cerr << image_paths[i] << " has the same timestamp as "
+                << sorted_paths.back() << "\n";
+      timestamps_s.clear();
+      return false;
+    }
+    sorted_paths.push_back(image_paths[i]);
+    sorted_timestamps_s.push_back(timestamps_s[i]);
+  }
+  image_paths.swap(sorted_paths);
+  timestamps_s.swap(sorted_timestamps_s);
+  return true;
+}
+
+} // namespace io
+} // namespace OpenICC
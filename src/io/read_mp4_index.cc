@@ -0,0 +1,333 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/io/read_mp4_index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace OpenICC {
+namespace io {
+
+namespace {
+
+// All integers in MP4 boxes are big endian
+uint32_t ReadU32(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t ReadU64(const uint8_t *p) {
+  return (uint64_t(ReadU32(p)) << 32) | uint64_t(ReadU32(p + 4));
+}
+
+struct Box {
+  std::string type;
+  const uint8_t *payload;
+  uint64_t payload_size;
+};
+
+// Splits a buffer into its child boxes
+std::vector<Box> ParseBoxes(const uint8_t *data, uint64_t size) {
+  std::vector<Box> boxes;
+  uint64_t pos = 0;
+  while (pos + 8 <= size) {
+    uint64_t box_size = ReadU32(data + pos);
+    uint64_t header_size = 8;
+    const std::string type(reinterpret_cast<const char *>(data + pos + 4), 4);
+    if (box_size == 1) {
+      if (pos + 16 > size) {
+        break;
+      }
+      box_size = ReadU64(data + pos + 8);
+      header_size = 16;
+    } else if (box_size == 0) {
+      box_size = size - pos;
+    }
+    if (box_size < header_size || pos + box_size > size) {
+      break;
+    }
+    boxes.push_back(
+        {type, data + pos + header_size, box_size - header_size});
+    pos += box_size;
+  }
+  return boxes;
+}
+
+const Box *FindBox(const std::vector<Box> &boxes, const std::string &type) {
+  for (const auto &box : boxes) {
+    if (box.type == type) {
+      return &box;
+    }
+  }
+  return nullptr;
+}
+
+bool IsVideoTrack(const Box &trak) {
+  const auto trak_boxes = ParseBoxes(trak.payload, trak.payload_size);
+  const Box *mdia = FindBox(trak_boxes, "mdia");
+  if (!mdia) {
+    return false;
+  }
+  const Box *hdlr =
+      FindBox(ParseBoxes(mdia->payload, mdia->payload_size), "hdlr");
+  // version/flags (4), pre_defined (4), handler_type (4)
+  return hdlr && hdlr->payload_size >= 12 &&
+         std::memcmp(hdlr->payload + 8, "vide", 4) == 0;
+}
+
+// Timescale of a mvhd or mdhd box: version/flags (4), creation and
+// modification time (4 or 8 each), timescale (4)
+uint32_t ReadTimescale(const Box &box) {
+  const uint64_t offset = box.payload[0] == 1 ? 20 : 12;
+  if (box.payload_size < offset + 4) {
+    return 0;
+  }
+  return ReadU32(box.payload + offset);
+}
+
+// Expands a (sample count, value) run length table (stts, ctts) to one value
+// per sample. Returns false if the table is damaged.
+bool ExpandSampleTable(const Box &box, const size_t nr_samples,
+                       std::vector<int64_t> &values, const bool is_signed) {
+  if (box.payload_size < 8) {
+    return false;
+  }
+  const uint32_t nr_entries = ReadU32(box.payload + 4);
+  if (8 + uint64_t(nr_entries) * 8 > box.payload_size) {
+    return false;
+  }
+  values.clear();
+  values.reserve(nr_samples);
+  for (uint32_t i = 0; i < nr_entries && values.size() < nr_samples; ++i) {
+    const uint32_t count = ReadU32(box.payload + 8 + 8 * i);
+    const uint32_t value = ReadU32(box.payload + 12 + 8 * i);
+    // ctts version 0 offsets are unsigned, but some muxers write negative
+    // ones anyway
+    const int64_t v = is_signed ? int64_t(int32_t(value)) : int64_t(value);
+    for (uint32_t c = 0; c < count && values.size() < nr_samples; ++c) {
+      values.push_back(v);
+    }
+  }
+  return values.size() == nr_samples;
+}
+
+} // namespace
+
+bool ReadMP4KeyframeIndex(const std::string &path_to_video,
+                          MP4FrameIndex &index) {
+  std::ifstream file(path_to_video, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Can not open " << path_to_video << "\n";
+    return false;
+  }
+
+  // only load the moov box, the media data can be several GB
+  std::vector<uint8_t> moov;
+  uint8_t header[16];
+  while (file.read(reinterpret_cast<char *>(header), 8)) {
+    uint64_t box_size = ReadU32(header);
+    uint64_t header_size = 8;
+    if (box_size == 1) {
+      if (!file.read(reinterpret_cast<char *>(header + 8), 8)) {
+        return false;
+      }
+      box_size = ReadU64(header + 8);
+      header_size = 16;
+    }
+    if (std::memcmp(header + 4, "moov", 4) == 0) {
+      if (box_size == 0 || box_size < header_size) {
+        return false;
+      }
+      moov.resize(box_size - header_size);
+      if (!file.read(reinterpret_cast<char *>(moov.data()), moov.size())) {
+        return false;
+      }
+      break;
+    }
+    if (box_size == 0 || box_size < header_size) {
+      return false;
+    }
+    file.seekg(box_size - header_size, std::ios::cur);
+  }
+  if (moov.empty()) {
+    return false;
+  }
+
+  const auto moov_boxes = ParseBoxes(moov.data(), moov.size());
+  const Box *mvhd = FindBox(moov_boxes, "mvhd");
+  for (const auto &trak : moov_boxes) {
+    if (trak.type != "trak" || !IsVideoTrack(trak)) {
+      continue;
+    }
+    const auto trak_boxes = ParseBoxes(trak.payload, trak.payload_size);
+    const Box *mdia = FindBox(trak_boxes, "mdia");
+    const auto mdia_boxes = ParseBoxes(mdia->payload, mdia->payload_size);
+    const Box *mdhd = FindBox(mdia_boxes, "mdhd");
+    const Box *minf = FindBox(mdia_boxes, "minf");
+    if (!minf) {
+      return false;
+    }
+    const Box *stbl =
+        FindBox(ParseBoxes(minf->payload, minf->payload_size), "stbl");
+    if (!stbl) {
+      return false;
+    }
+    const auto stbl_boxes = ParseBoxes(stbl->payload, stbl->payload_size);
+
+    // stsz: version/flags (4), sample_size (4), sample_count (4)
+    const Box *stsz = FindBox(stbl_boxes, "stsz");
+    if (!stsz || stsz->payload_size < 12) {
+      return false;
+    }
+    const size_t nr_samples = ReadU32(stsz->payload + 8);
+
+    // presentation time of every sample: decoding time + composition offset
+    const Box *stts = FindBox(stbl_boxes, "stts");
+    std::vector<int64_t> durations;
+    if (!stts || !ExpandSampleTable(*stts, nr_samples, durations, false)) {
+      return false;
+    }
+    std::vector<int64_t> offsets(nr_samples, 0);
+    const Box *ctts = FindBox(stbl_boxes, "ctts");
+    if (ctts && !ExpandSampleTable(*ctts, nr_samples, offsets, true)) {
+      return false;
+    }
+    std::vector<int64_t> presentation_times(nr_samples);
+    int64_t decode_time = 0;
+    for (size_t i = 0; i < nr_samples; ++i) {
+      presentation_times[i] = decode_time + offsets[i];
+      decode_time += durations[i];
+    }
+
+    // edts/elst: version/flags (4), entry_count (4), entries of
+    // segment_duration (4 or 8), media_time (4 or 8), media_rate (4).
+    // Only a single edit that cuts the media timeline is supported.
+    int64_t edit_start = std::numeric_limits<int64_t>::min();
+    int64_t edit_end = std::numeric_limits<int64_t>::max();
+    const Box *edts = FindBox(trak_boxes, "edts");
+    const Box *elst =
+        edts ? FindBox(ParseBoxes(edts->payload, edts->payload_size), "elst")
+             : nullptr;
+    if (elst) {
+      if (elst->payload_size < 8) {
+        return false;
+      }
+      const bool v1 = elst->payload[0] == 1;
+      const uint64_t entry_size = v1 ? 20 : 12;
+      const uint32_t nr_edits = ReadU32(elst->payload + 4);
+      if (nr_edits != 1 || 8 + entry_size > elst->payload_size) {
+        std::cerr << path_to_video << " has " << nr_edits
+                  << " edit list entries, frame numbers can not be "
+                     "mapped.\n";
+        return false;
+      }
+      const uint8_t *entry = elst->payload + 8;
+      const uint64_t segment_duration = v1 ? ReadU64(entry) : ReadU32(entry);
+      const int64_t media_time = v1 ? int64_t(ReadU64(entry + 8))
+                                    : int64_t(int32_t(ReadU32(entry + 4)));
+      const uint32_t media_rate = ReadU32(entry + (v1 ? 16 : 8));
+      if (media_time < 0 || media_rate != 0x10000) {
+        std::cerr << path_to_video << " has an empty or non unit rate edit, "
+                  << "frame numbers can not be mapped.\n";
+        return false;
+      }
+      edit_start = media_time;
+      // the segment duration is in movie time units
+      const uint32_t movie_timescale = mvhd ? ReadTimescale(*mvhd) : 0;
+      const uint32_t media_timescale = mdhd ? ReadTimescale(*mdhd) : 0;
+      if (segment_duration > 0 && movie_timescale > 0 && media_timescale > 0) {
+        edit_end = media_time + static_cast<int64_t>(
+                                    segment_duration * media_timescale /
+                                    movie_timescale);
+      }
+    }
+
+    // frame number of every presented sample
+    std::vector<size_t> presentation_order;
+    for (size_t i = 0; i < nr_samples; ++i) {
+      if (presentation_times[i] >= edit_start &&
+          presentation_times[i] < edit_end) {
+        presentation_order.push_back(i);
+      }
+    }
+    std::stable_sort(presentation_order.begin(), presentation_order.end(),
+                     [&presentation_times](const size_t a, const size_t b) {
+                       return presentation_times[a] < presentation_times[b];
+                     });
+    std::vector<int> frame_of_sample(nr_samples, -1);
+    for (size_t f = 0; f < presentation_order.size(); ++f) {
+      frame_of_sample[presentation_order[f]] = static_cast<int>(f);
+    }
+    index = MP4FrameIndex();
+    index.nr_frames = static_cast<int>(presentation_order.size());
+    index.reordered = !std::is_sorted(presentation_order.begin(),
+                                      presentation_order.end());
+
+    // stss: version/flags (4), entry_count (4), 1-based sample numbers
+    const Box *stss = FindBox(stbl_boxes, "stss");
+    if (!stss) {
+      // no sync sample table means that every frame is a keyframe
+      for (int f = 0; f < index.nr_frames; ++f) {
+        index.keyframes.push_back(f);
+      }
+      return true;
+    }
+    if (stss->payload_size < 8) {
+      return false;
+    }
+    const uint32_t nr_entries = ReadU32(stss->payload + 4);
+    if (8 + uint64_t(nr_entries) * 4 > stss->payload_size) {
+      return false;
+    }
+    for (uint32_t i = 0; i < nr_entries; ++i) {
+      const uint32_t sample = ReadU32(stss->payload + 8 + 4 * i);
+      if (sample >= 1 && sample <= nr_samples &&
+          frame_of_sample[sample - 1] >= 0) {
+        index.keyframes.push_back(frame_of_sample[sample - 1]);
+      }
+    }
+    std::sort(index.keyframes.begin(), index.keyframes.end());
+    return true;
+  }
+  return false;
+}
+
+std::vector<std::pair<int, int>>
+KeyframeAlignedChunks(const int nr_frames, const std::vector<int> &keyframes,
+                      const int min_chunk_frames) {
+  std::vector<std::pair<int, int>> chunks;
+  int chunk_start = 0;
+  for (const int keyframe : keyframes) {
+    if (keyframe <= chunk_start || keyframe >= nr_frames) {
+      continue;
+    }
+    if (keyframe - chunk_start >= min_chunk_frames) {
+      chunks.push_back(std::make_pair(chunk_start, keyframe));
+      chunk_start = keyframe;
+    }
+  }
+  if (chunk_start < nr_frames) {
+    chunks.push_back(std::make_pair(chunk_start, nr_frames));
+  }
+  return chunks;
+}
+
+} // namespace io
+} // namespace OpenICC
@@ -13,30 +13,78 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <ios>
 
 #include "OpenCameraCalibrator/io/read_scene.h"
+#include "OpenCameraCalibrator/io/corner_archive.h"
+#include "OpenCameraCalibrator/io/corner_dataset.h"
+#include "OpenCameraCalibrator/io/corner_stream.h"
+#include "OpenCameraCalibrator/utils/mapped_file.h"
 
 namespace OpenICC {
 namespace io {
 
 bool read_scene_bson(const std::string &input_bson,
                      nlohmann::json &scene_json) {
-  std::ifstream input_corner_json(input_bson, std::ios::binary);
-  if (!input_corner_json.is_open()) {
-    std::cerr << "Can not open " << input_bson << "\n";
+  // parse straight from the mapped file, without copying it to the heap
+  utils::MappedFile uson_file;
+  if (!uson_file.Open(input_bson)) {
     return false;
   }
-  // read the contents of the file into the vector
-  std::uint8_t cont;
-  std::vector<std::uint8_t> uson_file_content;
-  while (input_corner_json.read(reinterpret_cast<char *>(&cont), sizeof(cont))) {
-    uson_file_content.push_back(cont);
+  try {
+    scene_json = nlohmann::json::from_ubjson(uson_file.Data(), uson_file.Size());
+  } catch (const nlohmann::json::exception &e) {
+    std::cerr << "Can not parse " << input_bson << ": " << e.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool read_scene(const std::string &input_path, nlohmann::json &scene_json) {
+  return read_scene(input_path, ViewSelection(), scene_json);
+}
+
+bool read_scene(const std::string &input_path, const ViewSelection &selection,
+                nlohmann::json &scene_json) {
+  std::ifstream input_file(input_path, std::ios::binary);
+  if (!input_file.is_open()) {
+    std::cerr << "Can not open " << input_path << "\n";
+    return false;
+  }
+  char magic[4] = {0, 0, 0, 0};
+  input_file.read(magic, 4);
+  input_file.close();
+  if (std::string(magic, 4) == "OICC") {
+    return read_scene_corner_stream(input_path, selection, scene_json);
+  }
+  // archives are decoded block by block and filtered afterwards
+  const bool archive = std::string(magic, 4) == "OICZ";
+  if (archive ? !read_scene_corner_archive(input_path, scene_json)
+              : !read_scene_bson(input_path, scene_json)) {
+    return false;
+  }
+  if (selection.SelectsAll() || !scene_json.contains("views")) {
+    return true;
+  }
+  // the view keys are not ordered by time
+  std::vector<std::pair<double, std::string>> views;
+  for (const auto &view : scene_json["views"].items()) {
+    const double timestamp_s = std::stod(view.key()) * US_TO_S;
+    if (timestamp_s >= selection.start_s && timestamp_s <= selection.end_s) {
+      views.push_back(std::make_pair(timestamp_s, view.key()));
+    }
   }
-  scene_json = nlohmann::json::from_ubjson(uson_file_content);
-  input_corner_json.close();
+  std::sort(views.begin(), views.end());
+  nlohmann::json selected_views = nlohmann::json::object();
+  const size_t stride = std::max(1, selection.every_kth_view);
+  for (size_t i = 0; i < views.size(); i += stride) {
+    selected_views[views[i].second] =
+        std::move(scene_json["views"][views[i].second]);
+  }
+  scene_json["views"] = std::move(selected_views);
   return true;
 }
 
@@ -58,5 +106,17 @@ void scene_points_to_calib_dataset(
   }
 }
 
+void scene_points_to_calib_dataset(const CornerDataset &dataset,
+                                   theia::Reconstruction &reconstruction) {
+  const CornerStreamHeader &header = dataset.Header();
+  for (size_t i = 0; i < header.scene_pt_ids.size(); ++i) {
+    const theia::TrackId track_id = (theia::TrackId)header.scene_pt_ids[i];
+    reconstruction.AddTrack(track_id);
+    theia::Track *track = reconstruction.MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = header.scene_pts[i].homogeneous();
+  }
+}
+
 } // namespace io
 } // namespace OpenICC
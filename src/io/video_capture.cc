@@ -0,0 +1,79 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCameraCalibrator/io/video_capture.h"
+
+#include <iostream>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio/registry.hpp>
+
+namespace OpenICC {
+namespace io {
+
+bool OpenVideoCapture(const std::string &path_to_video,
+                      const VideoDecodeOptions &options,
+                      cv::VideoCapture &capture, VideoDecodeOptions &decoded) {
+  decoded = VideoDecodeOptions();
+  const bool scale = options.downsample_factor > 1.0;
+  if (!options.gray && !scale) {
+    return capture.open(path_to_video);
+  }
+  if (!cv::videoio_registry::hasBackend(cv::CAP_GSTREAMER)) {
+    std::cerr << "OpenCV has no GStreamer backend. Decoding full resolution "
+                 "BGR frames of "
+              << path_to_video << ".\n";
+    return capture.open(path_to_video);
+  }
+  std::string caps =
+      options.gray ? "video/x-raw,format=GRAY8" : "video/x-raw,format=BGR";
+  if (scale) {
+    // the output size has to be known for the caps. The capture is opened
+    // with the default backend to read it and reopened with the pipeline.
+    if (!capture.open(path_to_video)) {
+      return false;
+    }
+    const int width = cvRound(capture.get(cv::CAP_PROP_FRAME_WIDTH) /
+                              options.downsample_factor);
+    const int height = cvRound(capture.get(cv::CAP_PROP_FRAME_HEIGHT) /
+                               options.downsample_factor);
+    if (width > 0 && height > 0) {
+      caps += ",width=" + std::to_string(width) +
+              ",height=" + std::to_string(height);
+    } else {
+      std::cerr << "Unknown frame size of " << path_to_video
+                << ". Resizing the decoded frames instead.\n";
+    }
+  }
+  // convert before scaling, for gray output videoconvert only copies the Y
+  // plane and videoscale then works on a single channel
+  const std::string pipeline = "filesrc location=\"" + path_to_video +
+                               "\" ! decodebin ! videoconvert ! "
+                               "videoscale ! " +
+                               caps + " ! appsink sync=false";
+  if (capture.open(pipeline, cv::CAP_GSTREAMER)) {
+    decoded.gray = options.gray;
+    decoded.gstreamer = true;
+    if (caps.find("width=") != std::string::npos) {
+      decoded.downsample_factor = options.downsample_factor;
+    }
+    return true;
+  }
+  std::cerr << "Could not open " << path_to_video
+            << " with GStreamer. Decoding full resolution BGR frames.\n";
+  return capture.open(path_to_video);
+}
+
+} // namespace io
+} // namespace OpenICC
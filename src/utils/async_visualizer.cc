@@ -0,0 +1,105 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/utils/async_visualizer.h"
+
+#include <glog/logging.h>
+
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace OpenICC {
+namespace utils {
+
+AsyncVisualizer::AsyncVisualizer(const std::string &window_name,
+                                 const std::string &output_video,
+                                 const double fps, const size_t queue_size)
+    : window_name_(window_name), output_video_(output_video),
+      fps_(fps > 0.0 ? fps : 30.0), queue_(queue_size) {
+  consumer_ = std::thread(&AsyncVisualizer::Consume, this);
+}
+
+AsyncVisualizer::~AsyncVisualizer() { Close(); }
+
+void AsyncVisualizer::Show(const cv::Mat &image, Annotator annotate) {
+  if (image.empty()) {
+    return;
+  }
+  // a recorded video should contain every frame
+  if (!output_video_.empty()) {
+    queue_.Push(Frame{image, std::move(annotate)});
+    return;
+  }
+  bool dropped = false;
+  if (queue_.PushDropOldest(Frame{image, std::move(annotate)}, dropped) &&
+      dropped) {
+    ++num_dropped_;
+  }
+}
+
+void AsyncVisualizer::Close() {
+  queue_.Close();
+  if (consumer_.joinable()) {
+    consumer_.join();
+    if (writer_.isOpened()) {
+      writer_.release();
+      LOG(INFO) << "Wrote " << num_shown_ << " frames to " << output_video_
+                << ", dropped " << num_dropped_ << " frames.";
+    } else if (num_dropped_ > 0) {
+      LOG(INFO) << "Visualization dropped " << num_dropped_ << " of "
+                << num_shown_ + num_dropped_ << " frames.";
+    }
+  }
+}
+
+void AsyncVisualizer::Consume() {
+  Frame frame;
+  while (queue_.Pop(frame)) {
+    cv::Mat image = frame.image;
+    if (image.channels() == 1) {
+      cv::cvtColor(image, image, cv::COLOR_GRAY2BGR);
+    }
+    if (frame.annotate) {
+      frame.annotate(image);
+    }
+    if (output_video_.empty()) {
+      cv::imshow(window_name_, image);
+      cv::waitKey(1);
+    } else {
+      // the frame size is only known with the first frame
+      if (!writer_.isOpened() &&
+          !writer_.open(output_video_,
+                        cv::VideoWriter::fourcc('m', 'p', '4', 'v'), fps_,
+                        image.size())) {
+        LOG(ERROR) << "Could not open " << output_video_
+                   << " for writing. Disabling visualization.";
+        queue_.Close();
+        while (queue_.Pop(frame)) {
+        }
+        return;
+      }
+      if (writer_size_.empty()) {
+        writer_size_ = image.size();
+      }
+      if (image.size() != writer_size_) {
+        cv::resize(image, image, writer_size_);
+      }
+      writer_.write(image);
+    }
+    ++num_shown_;
+  }
+}
+
+} // namespace utils
+} // namespace OpenICC
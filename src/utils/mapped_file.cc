@@ -0,0 +1,75 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/utils/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+namespace OpenICC {
+namespace utils {
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &path, const bool sequential) {
+  Close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Can not open " << path << "\n";
+    return false;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    std::cerr << "Can not stat " << path << "\n";
+    ::close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  is_open_ = true;
+  if (size_ == 0) {
+    // empty files can not be mapped
+    ::close(fd);
+    return true;
+  }
+  void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Can not map " << path << "\n";
+    size_ = 0;
+    is_open_ = false;
+    return false;
+  }
+  if (sequential) {
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+  }
+  data_ = static_cast<const std::uint8_t *>(data);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    ::munmap(const_cast<std::uint8_t *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+}
+
+} // namespace utils
+} // namespace OpenICC
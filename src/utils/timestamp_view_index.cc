@@ -0,0 +1,105 @@
+/* Copyright (C) 2021 Steffen Urban
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "OpenCameraCalibrator/utils/timestamp_view_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "OpenCameraCalibrator/utils/types.h"
+
+namespace OpenICC {
+namespace utils {
+
+namespace {
+
+bool TimestampLess(const std::pair<int64_t, theia::ViewId> &entry,
+                   const int64_t timestamp_ns) {
+  return entry.first < timestamp_ns;
+}
+
+} // namespace
+
+int64_t TimestampSToNs(const double timestamp_s) {
+  return std::llround(timestamp_s * S_TO_NS);
+}
+
+std::string ViewNameFromTimestampNs(const int64_t timestamp_ns) {
+  return std::to_string(timestamp_ns);
+}
+
+TimestampViewIndex::TimestampViewIndex(
+    const theia::Reconstruction &reconstruction) {
+  entries_.reserve(reconstruction.NumViews());
+  for (const theia::ViewId view_id : reconstruction.ViewIds()) {
+    entries_.emplace_back(
+        TimestampSToNs(reconstruction.View(view_id)->GetTimestamp()), view_id);
+  }
+  std::sort(entries_.begin(), entries_.end());
+}
+
+bool TimestampViewIndex::Add(const int64_t timestamp_ns,
+                             const theia::ViewId view_id) {
+  if (entries_.empty() || entries_.back().first < timestamp_ns) {
+    entries_.emplace_back(timestamp_ns, view_id);
+    return true;
+  }
+  const auto it = std::lower_bound(entries_.begin(), entries_.end(),
+                                   timestamp_ns, TimestampLess);
+  if (it != entries_.end() && it->first == timestamp_ns) {
+    return false;
+  }
+  entries_.emplace(it, timestamp_ns, view_id);
+  return true;
+}
+
+bool TimestampViewIndex::Remove(const int64_t timestamp_ns) {
+  const auto it = std::lower_bound(entries_.begin(), entries_.end(),
+                                   timestamp_ns, TimestampLess);
+  if (it == entries_.end() || it->first != timestamp_ns) {
+    return false;
+  }
+  entries_.erase(it);
+  return true;
+}
+
+theia::ViewId TimestampViewIndex::Find(const int64_t timestamp_ns) const {
+  return FindNearest(timestamp_ns, 0);
+}
+
+theia::ViewId
+TimestampViewIndex::FindNearest(const int64_t timestamp_ns,
+                                const int64_t max_distance_ns) const {
+  const auto it = std::lower_bound(entries_.begin(), entries_.end(),
+                                   timestamp_ns, TimestampLess);
+  // the closest entry is either the first one not before the timestamp or
+  // the one before it
+  auto nearest = entries_.end();
+  if (it != entries_.end()) {
+    nearest = it;
+  }
+  if (it != entries_.begin() &&
+      (nearest == entries_.end() ||
+       timestamp_ns - std::prev(it)->first < nearest->first - timestamp_ns)) {
+    nearest = std::prev(it);
+  }
+  if (nearest == entries_.end() ||
+      std::abs(nearest->first - timestamp_ns) > max_distance_ns) {
+    return theia::kInvalidViewId;
+  }
+  return nearest->second;
+}
+
+} // namespace utils
+} // namespace OpenICC
@@ -23,6 +23,7 @@
 #include <theia/sfm/camera/pinhole_camera_model.h>
 
 #include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <vector>
 
@@ -42,6 +43,13 @@ bool DoesFileExist(const std::string &path) {
 
 bool ReadDetectorParameters(std::string filename,
                             Ptr<aruco::DetectorParameters> &params) {
+  double camera_motion_speed;
+  return ReadDetectorParameters(filename, params, camera_motion_speed);
+}
+
+bool ReadDetectorParameters(std::string filename,
+                            Ptr<aruco::DetectorParameters> &params,
+                            double &camera_motion_speed) {
   FileStorage fs(filename, FileStorage::READ);
   if (!fs.isOpened())
     return false;
@@ -66,12 +74,36 @@ bool ReadDetectorParameters(std::string filename,
   fs["maxErroneousBitsInBorderRate"] >> params->maxErroneousBitsInBorderRate;
   fs["minOtsuStdDev"] >> params->minOtsuStdDev;
   fs["errorCorrectionRate"] >> params->errorCorrectionRate;
-  //  fs["useAruco3Detection"] >> params->useAruco3Detection;
-  //  if (params->useAruco3Detection) {
-  //      params->cornerRefinementMethod = aruco::CORNER_REFINE_SUBPIX;
-  //  }
-  //  fs["cameraMotionSpeed"] >> params->cameraMotionSpeed;
-  //  fs["useGlobalThreshold"] >> params->useGlobalThreshold;
+  // only a single thresholding window instead of the window size sweep
+  if (!fs["useGlobalThreshold"].empty() && (int)fs["useGlobalThreshold"] &&
+      !fs["adaptiveThreshWinSize"].empty()) {
+    fs["adaptiveThreshWinSize"] >> params->adaptiveThreshWinSizeMin;
+    params->adaptiveThreshWinSizeMax = params->adaptiveThreshWinSizeMin;
+  }
+  camera_motion_speed = 0.0;
+  if (!fs["cameraMotionSpeed"].empty()) {
+    fs["cameraMotionSpeed"] >> camera_motion_speed;
+  }
+#if OPENICC_HAS_ARUCO3
+  if (!fs["useAruco3Detection"].empty()) {
+    fs["useAruco3Detection"] >> params->useAruco3Detection;
+  }
+  if (!fs["minSideLengthCanonicalImg"].empty()) {
+    fs["minSideLengthCanonicalImg"] >> params->minSideLengthCanonicalImg;
+  }
+  if (!fs["minMarkerLengthRatioOriginalImg"].empty()) {
+    fs["minMarkerLengthRatioOriginalImg"] >>
+        params->minMarkerLengthRatioOriginalImg;
+  }
+  if (params->useAruco3Detection) {
+    params->cornerRefinementMethod = aruco::CORNER_REFINE_SUBPIX;
+  }
+#else
+  if (!fs["useAruco3Detection"].empty() && (int)fs["useAruco3Detection"]) {
+    std::cerr << "ArUco3 detection needs OpenCV >= 4.5.3. Using the classic "
+                 "marker detection.\n";
+  }
+#endif
   return true;
 }
 
@@ -164,18 +196,79 @@ double GetReprojErrorOfView(const theia::Reconstruction &recon_dataset,
   return view_reproj_error;
 }
 
+namespace {
+
+//! Orders digit runs by their value, e.g. img_2.png before img_10.png
+bool NaturalLess(const std::string &a, const std::string &b) {
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (std::isdigit(static_cast<unsigned char>(a[i])) &&
+        std::isdigit(static_cast<unsigned char>(b[j]))) {
+      const size_t a_start = i, b_start = j;
+      while (i < a.size() && std::isdigit(static_cast<unsigned char>(a[i]))) {
+        ++i;
+      }
+      while (j < b.size() && std::isdigit(static_cast<unsigned char>(b[j]))) {
+        ++j;
+      }
+      // compare the values without leading zeros by length, then by digits
+      const size_t a_first = std::min(a.find_first_not_of('0', a_start), i);
+      const size_t b_first = std::min(b.find_first_not_of('0', b_start), j);
+      if (i - a_first != j - b_first) {
+        return i - a_first < j - b_first;
+      }
+      const int cmp = a.compare(a_first, i - a_first, b, b_first, j - b_first);
+      if (cmp != 0) {
+        return cmp < 0;
+      }
+    } else {
+      if (a[i] != b[j]) {
+        return a[i] < b[j];
+      }
+      ++i;
+      ++j;
+    }
+  }
+  if (a.size() - i != b.size() - j) {
+    return a.size() - i < b.size() - j;
+  }
+  // equal values with different leading zeros
+  return a < b;
+}
+
+} // namespace
+
 std::vector<std::string> load_images(const std::string &img_dir_path) {
+  std::vector<std::string> img_paths;
   DIR *dir;
   if ((dir = opendir(img_dir_path.c_str())) == nullptr) {
+    return img_paths;
   }
-  std::vector<std::string> img_paths;
+  const std::vector<std::string> img_extensions = {
+      ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm"};
   dirent *dp;
   for (dp = readdir(dir); dp != nullptr; dp = readdir(dir)) {
-    img_paths.push_back(img_dir_path + "/" + std::string(dp->d_name));
+    const std::string name(dp->d_name);
+    // skip ".", ".." and hidden files
+    if (name.empty() || name[0] == '.') {
+      continue;
+    }
+    const size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) {
+      continue;
+    }
+    std::string extension = name.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   ::tolower);
+    if (std::find(img_extensions.begin(), img_extensions.end(), extension) ==
+        img_extensions.end()) {
+      continue;
+    }
+    img_paths.push_back(img_dir_path + "/" + name);
   }
   closedir(dir);
 
-  std::sort(img_paths.begin(), img_paths.end());
+  std::sort(img_paths.begin(), img_paths.end(), NaturalLess);
   return img_paths;
 }
 